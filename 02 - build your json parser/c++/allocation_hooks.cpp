@@ -0,0 +1,35 @@
+// Replaces the global operator new/delete so that profile.cpp can count every
+// allocation in the program. Linked only into the json_parser and json_bench
+// executables; programs using the library keep their own allocator.
+
+#include "profile.hpp"
+#include <cstdlib>
+#include <new>
+
+void *operator new(size_t size)
+{
+    recordAllocation(size);
+    if (void *p = std::malloc(size == 0 ? 1 : size))
+    {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+// Kept out of line so the compiler does not pair the inlined free() with a
+// new-expression and warn about mismatched allocation functions
+#if defined(__GNUC__)
+#define PROFILE_NOINLINE __attribute__((noinline))
+#else
+#define PROFILE_NOINLINE
+#endif
+
+PROFILE_NOINLINE void operator delete(void *p) noexcept
+{
+    std::free(p);
+}
+
+PROFILE_NOINLINE void operator delete(void *p, size_t) noexcept
+{
+    std::free(p);
+}
@@ -0,0 +1,490 @@
+// json_bench - throughput and allocation benchmark for the JSON parser
+//
+// Generates representative corpora (or uses files given with --file) and
+// measures each phase of a parse run separately:
+//
+//   lex        Lexer only, tokens are discarded
+//   lex+parse  a full parse into a JsonValue tree; the Parser pulls its
+//              tokens from the Lexer, so this includes the lex phase's work
+//   serialize  JsonValue::write into an in-memory OutputBuffer
+//   teardown   destroying the parsed trees
+//
+// Throughput is always reported against the corpus input size so phases can
+// be compared with each other. Each phase runs --repeat times and the fastest
+// run is kept. Allocation counts come from the counters in profile.hpp and are
+// reported per document (per line for NDJSON and JSON Lines corpora).
+
+#include "json_parser.hpp"
+#include "mapped_file.hpp"
+#include "output_buffer.hpp"
+#include "profile.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct Corpus
+{
+    std::string name;
+    std::string text;
+    bool ndjson; // one document per line
+};
+
+struct Result
+{
+    std::string corpus;
+    std::string phase;
+    double mbPerSecond;
+    double allocsPerDoc;
+    double bytesPerDoc;
+};
+
+// Small deterministic generator so corpora are identical between runs
+struct Random
+{
+    uint64_t state = 0x9E3779B97F4A7C15ull;
+
+    uint64_t next()
+    {
+        state ^= state << 13;
+        state ^= state >> 7;
+        state ^= state << 17;
+        return state;
+    }
+    size_t below(size_t n) { return static_cast<size_t>(next() % n); }
+};
+
+static const char *const WORDS[] = {"alpha", "bravo", "charlie", "delta", "echo", "foxtrot", "golf", "hotel",
+                                    "india", "juliet", "kilo", "lima", "mike", "november", "oscar", "papa"};
+
+static std::string randomNumber(Random &rng)
+{
+    switch (rng.below(4))
+    {
+    case 0:
+        return std::to_string(rng.below(1000000));
+    case 1:
+        return "-" + std::to_string(rng.below(100000));
+    case 2:
+        return std::to_string(rng.below(100000)) + "." + std::to_string(rng.below(1000000));
+    default:
+        return std::to_string(rng.below(10)) + "." + std::to_string(rng.below(1000)) + "e" +
+               std::to_string(static_cast<int>(rng.below(40)) - 20);
+    }
+}
+
+static std::string randomText(Random &rng, size_t words)
+{
+    std::string text;
+    for (size_t i = 0; i < words; i++)
+    {
+        if (i > 0)
+        {
+            text += ' ';
+        }
+        text += WORDS[rng.below(16)];
+        // Sprinkle in escapes and non-ASCII text
+        switch (rng.below(20))
+        {
+        case 0:
+            text += "\\n";
+            break;
+        case 1:
+            text += "\\\"quoted\\\"";
+            break;
+        case 2:
+            text += "\\u00e9";
+            break;
+        case 3:
+            text += "\xc3\xa9t\xc3\xa9";
+            break;
+        default:
+            break;
+        }
+    }
+    return text;
+}
+
+static Corpus numberCorpus(size_t size)
+{
+    Random rng;
+    std::string text = "[";
+    while (text.size() < size)
+    {
+        text += randomNumber(rng);
+        text += ",";
+    }
+    text += "0]";
+    return {"numbers", text, false};
+}
+
+static Corpus stringCorpus(size_t size)
+{
+    Random rng;
+    std::string text = "[";
+    while (text.size() < size)
+    {
+        text += "\"" + randomText(rng, 8 + rng.below(40)) + "\",";
+    }
+    text += "\"\"]";
+    return {"strings", text, false};
+}
+
+static Corpus nestedCorpus(size_t size)
+{
+    // Many subtrees, each 200 levels deep (within the default depth limit)
+    Random rng;
+    std::string text = "[";
+    while (text.size() < size)
+    {
+        for (int level = 0; level < 100; level++)
+        {
+            text += "{\"level\":" + std::to_string(level) + ",\"next\":[";
+        }
+        text += randomNumber(rng);
+        for (int level = 0; level < 100; level++)
+        {
+            text += "]}";
+        }
+        text += ",";
+    }
+    text += "null]";
+    return {"nested", text, false};
+}
+
+static Corpus wideCorpus(size_t size)
+{
+    Random rng;
+    std::string text = "{";
+    for (size_t key = 0; text.size() < size; key++)
+    {
+        text += "\"key_" + std::to_string(key) + "\":";
+        text += rng.below(2) == 0 ? randomNumber(rng) : "\"" + randomText(rng, 2) + "\"";
+        text += ",";
+    }
+    text += "\"last\":null}";
+    return {"wide", text, false};
+}
+
+static Corpus ndjsonCorpus(size_t size)
+{
+    Random rng;
+    std::string text;
+    for (size_t id = 0; text.size() < size; id++)
+    {
+        text += "{\"user\":{\"id\":" + std::to_string(id) + ",\"name\":\"" + WORDS[rng.below(16)] +
+                "\"},\"event\":{\"ts\":" + std::to_string(1700000000 + id) + ",\"type\":\"" +
+                WORDS[rng.below(16)] + "\",\"ok\":" + (rng.below(2) ? "true" : "false") +
+                "},\"tags\":[\"" + WORDS[rng.below(16)] + "\",\"" + WORDS[rng.below(16)] +
+                "\"],\"score\":" + randomNumber(rng) + "}\n";
+    }
+    return {"ndjson", text, true};
+}
+
+// Splits a corpus into its documents as (offset, length) pairs
+static std::vector<std::pair<size_t, size_t>> documents(const Corpus &corpus)
+{
+    std::vector<std::pair<size_t, size_t>> docs;
+    if (!corpus.ndjson)
+    {
+        docs.push_back({0, corpus.text.size()});
+        return docs;
+    }
+
+    size_t start = 0;
+    while (start < corpus.text.size())
+    {
+        size_t end = corpus.text.find('\n', start);
+        if (end == std::string::npos)
+        {
+            end = corpus.text.size();
+        }
+        if (end > start)
+        {
+            docs.push_back({start, end - start});
+        }
+        start = end + 1;
+    }
+    return docs;
+}
+
+static bool hasExtension(const std::string &path, const std::string &extension)
+{
+    return path.size() > extension.size() &&
+           path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+static double secondsSince(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+static void runCorpus(const Corpus &corpus, int repeat, std::vector<Result> &results)
+{
+    auto docs = documents(corpus);
+    double megabytes = corpus.text.size() / (1024.0 * 1024.0);
+    const char *data = corpus.text.data();
+
+    std::map<std::string, double> best;
+    std::map<std::string, size_t> allocs;
+    std::map<std::string, size_t> bytes;
+
+    // Records the fastest time and the allocations of one phase run
+    auto record = [&](const std::string &phase, double seconds, size_t allocations, size_t allocated)
+    {
+        if (best.count(phase) == 0 || seconds < best[phase])
+        {
+            best[phase] = seconds;
+        }
+        allocs[phase] = allocations;
+        bytes[phase] = allocated;
+    };
+
+    std::vector<JsonPtr> trees;
+    trees.reserve(docs.size());
+
+    for (int run = 0; run < repeat; run++)
+    {
+        size_t allocsBefore = allocationCount();
+        size_t bytesBefore = allocatedBytes();
+        auto start = std::chrono::steady_clock::now();
+        size_t tokens = 0;
+        for (const auto &doc : docs)
+        {
+            Lexer lexer(data + doc.first, doc.second);
+            while (lexer.getNextToken().type != TokenType::EOF_TOKEN)
+            {
+                tokens++;
+            }
+        }
+        record("lex", secondsSince(start), allocationCount() - allocsBefore, allocatedBytes() - bytesBefore);
+
+        allocsBefore = allocationCount();
+        bytesBefore = allocatedBytes();
+        start = std::chrono::steady_clock::now();
+        for (const auto &doc : docs)
+        {
+            Lexer lexer(data + doc.first, doc.second);
+            Parser parser(lexer);
+            trees.push_back(parser.parse());
+        }
+        record("lex+parse", secondsSince(start), allocationCount() - allocsBefore, allocatedBytes() - bytesBefore);
+
+        OutputBuffer out;
+        out.str().reserve(corpus.text.size() * 2);
+        allocsBefore = allocationCount();
+        bytesBefore = allocatedBytes();
+        start = std::chrono::steady_clock::now();
+        for (const auto &tree : trees)
+        {
+            out.str().clear();
+            tree->write(out);
+        }
+        record("serialize", secondsSince(start), allocationCount() - allocsBefore, allocatedBytes() - bytesBefore);
+
+        allocsBefore = allocationCount();
+        bytesBefore = allocatedBytes();
+        start = std::chrono::steady_clock::now();
+        trees.clear();
+        record("teardown", secondsSince(start), allocationCount() - allocsBefore, allocatedBytes() - bytesBefore);
+    }
+
+    for (const char *phase : {"lex", "lex+parse", "serialize", "teardown"})
+    {
+        results.push_back({corpus.name, phase, megabytes / best[phase],
+                           static_cast<double>(allocs[phase]) / docs.size(),
+                           static_cast<double>(bytes[phase]) / docs.size()});
+    }
+}
+
+static std::map<std::string, Result> loadBaseline(const std::string &path)
+{
+    std::map<std::string, Result> baseline;
+    std::ifstream in(path);
+    std::string line;
+    while (std::getline(in, line))
+    {
+        std::istringstream fields(line);
+        Result r;
+        if (fields >> r.corpus >> r.phase >> r.mbPerSecond >> r.allocsPerDoc >> r.bytesPerDoc)
+        {
+            baseline[r.corpus + "/" + r.phase] = r;
+        }
+    }
+    return baseline;
+}
+
+static void printResults(const std::vector<Result> &results, const std::map<std::string, Result> &baseline)
+{
+    std::printf("%-10s %-10s %10s %14s %14s", "corpus", "phase", "MB/s", "allocs/doc", "bytes/doc");
+    if (!baseline.empty())
+    {
+        std::printf(" %10s %12s", "MB/s diff", "allocs diff");
+    }
+    std::printf("\n");
+
+    for (const auto &r : results)
+    {
+        std::printf("%-10s %-10s %10.1f %14.1f %14.1f", r.corpus.c_str(), r.phase.c_str(), r.mbPerSecond,
+                    r.allocsPerDoc, r.bytesPerDoc);
+
+        auto it = baseline.find(r.corpus + "/" + r.phase);
+        if (it != baseline.end())
+        {
+            const Result &base = it->second;
+            double speed = base.mbPerSecond > 0 ? (r.mbPerSecond / base.mbPerSecond - 1) * 100 : 0;
+            double allocs = base.allocsPerDoc > 0 ? (r.allocsPerDoc / base.allocsPerDoc - 1) * 100 : 0;
+            std::printf(" %+9.1f%% %+11.1f%%", speed, allocs);
+        }
+        std::printf("\n");
+    }
+}
+
+static void usage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "\n"
+              << "  --size <MB>            size of each generated corpus (default 8)\n"
+              << "  --repeat <n>           runs per phase, fastest is kept (default 3)\n"
+              << "  --corpus <name>        only run numbers|strings|nested|wide|ndjson\n"
+              << "  --file <path>          also benchmark a file (.ndjson, .jsonl: one document per line)\n"
+              << "  --write-corpora <dir>  save the generated corpora as files and exit\n"
+              << "  --save <path>          store results as a baseline\n"
+              << "  --compare <path>       show the change against a stored baseline\n";
+}
+
+int main(int argc, char **argv)
+{
+    size_t sizeMb = 8;
+    int repeat = 3;
+    std::string only, savePath, comparePath, corpusDir;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (i + 1 >= argc)
+        {
+            usage(argv[0]);
+            return 2;
+        }
+        if (arg == "--size")
+        {
+            sizeMb = std::strtoul(argv[++i], nullptr, 10);
+        }
+        else if (arg == "--repeat")
+        {
+            repeat = std::atoi(argv[++i]);
+        }
+        else if (arg == "--corpus")
+        {
+            only = argv[++i];
+        }
+        else if (arg == "--file")
+        {
+            files.push_back(argv[++i]);
+        }
+        else if (arg == "--write-corpora")
+        {
+            corpusDir = argv[++i];
+        }
+        else if (arg == "--save")
+        {
+            savePath = argv[++i];
+        }
+        else if (arg == "--compare")
+        {
+            comparePath = argv[++i];
+        }
+        else
+        {
+            usage(argv[0]);
+            return 2;
+        }
+    }
+    if (sizeMb == 0 || repeat < 1)
+    {
+        usage(argv[0]);
+        return 2;
+    }
+
+    size_t size = sizeMb * 1024 * 1024;
+    Corpus (*generators[])(size_t) = {numberCorpus, stringCorpus, nestedCorpus, wideCorpus, ndjsonCorpus};
+    const char *names[] = {"numbers", "strings", "nested", "wide", "ndjson"};
+
+    std::vector<Corpus> corpora;
+    for (size_t i = 0; i < 5; i++)
+    {
+        if (only.empty() || only == names[i])
+        {
+            corpora.push_back(generators[i](size));
+        }
+    }
+    for (const auto &path : files)
+    {
+        MappedFile file;
+        if (!file.open(path))
+        {
+            std::cerr << "Error: Could not read file " << path << "\n";
+            return 2;
+        }
+        bool ndjson = hasExtension(path, ".ndjson") || hasExtension(path, ".jsonl");
+        corpora.push_back({path.substr(path.find_last_of('/') + 1), std::string(file.data(), file.size()), ndjson});
+    }
+
+    if (!corpusDir.empty())
+    {
+        for (const auto &corpus : corpora)
+        {
+            std::string path = corpusDir + "/" + corpus.name + (corpus.ndjson ? ".ndjson" : ".json");
+            std::ofstream out(path, std::ios::binary);
+            out << corpus.text;
+            std::cout << "Wrote " << path << "\n";
+        }
+        return 0;
+    }
+
+    std::vector<Result> results;
+    enableAllocationCounting(true);
+    try
+    {
+        for (const auto &corpus : corpora)
+        {
+            runCorpus(corpus, repeat, results);
+        }
+    }
+    catch (const std::exception &e)
+    {
+        std::cerr << "Benchmark failed: " << e.what() << "\n";
+        return 1;
+    }
+
+    std::map<std::string, Result> baseline;
+    if (!comparePath.empty())
+    {
+        baseline = loadBaseline(comparePath);
+        if (baseline.empty())
+        {
+            std::cerr << "Error: No baseline results in " << comparePath << "\n";
+            return 2;
+        }
+    }
+    printResults(results, baseline);
+
+    if (!savePath.empty())
+    {
+        std::ofstream out(savePath);
+        for (const auto &r : results)
+        {
+            out << r.corpus << " " << r.phase << " " << r.mbPerSecond << " " << r.allocsPerDoc << " "
+                << r.bytesPerDoc << "\n";
+        }
+    }
+    return 0;
+}
@@ -1,14 +1,77 @@
 #!/bin/bash
 # build.sh - Simple build script for Unix/Linux/Mac
+#
+# Usage:
+#   ./build.sh          build the json_parser executable
+#   ./build.sh bench    build the json_bench benchmark
+#   ./build.sh all      build both
+#   ./build.sh check    build and run the checks in tests/
 
-echo "Building JSON Parser..."
+# Library sources shared by every executable
+SOURCES="lexer.cpp parser.cpp lazy_document.cpp structural_scan.cpp mapped_file.cpp output_buffer.cpp snapshot.cpp profile.cpp formatter.cpp query.cpp structural_hash.cpp columnar.cpp incremental.cpp"
+# Allocation counting for --profile and the benchmark; only the executables
+# link it, so the library keeps the default operator new
+HOOKS="allocation_hooks.cpp"
+FLAGS="-std=c++14 -Wall -Wextra -O2"
 
-# Compile all source files and link them
-g++ -std=c++14 -Wall -Wextra -O2 -o json_parser main.cpp json_parser.cpp
+cd "$(dirname "$0")" || exit 1
 
-if [ $? -eq 0 ]; then
-    echo "Build successful! Executable: json_parser"
-else
-    echo "Build failed!"
-    exit 1
-fi
+build()
+{
+    local name=$1
+    shift
+    echo "Building $name..."
+
+    # Compile all source files and link them
+    g++ $FLAGS -I. -o "$name" "$@" $SOURCES
+
+    if [ $? -eq 0 ]; then
+        echo "Build successful! Executable: $name"
+    else
+        echo "Build failed!"
+        exit 1
+    fi
+}
+
+# Builds and runs every tests/*_check.cpp; the library is compiled once and
+# linked into each of them
+check()
+{
+    local objects
+    objects=$(mktemp -d) || exit 1
+    trap 'rm -rf "$objects"' EXIT
+
+    echo "Building library..."
+    for source in $SOURCES; do
+        g++ $FLAGS -I. -c "$source" -o "$objects/${source%.cpp}.o" || exit 1
+    done
+
+    for test in tests/*_check.cpp; do
+        local name
+        name=$(basename "$test" .cpp)
+        echo "Running $name..."
+        g++ $FLAGS -I. -o "$objects/$name" "$test" "$objects"/*.o || exit 1
+        "$objects/$name" || exit 1
+    done
+    echo "All checks passed"
+}
+
+case "${1:-parser}" in
+parser)
+    build json_parser main.cpp $HOOKS
+    ;;
+bench)
+    build json_bench bench/json_bench.cpp $HOOKS
+    ;;
+all)
+    build json_parser main.cpp $HOOKS
+    build json_bench bench/json_bench.cpp $HOOKS
+    ;;
+check)
+    check
+    ;;
+*)
+    echo "Usage: $0 [parser|bench|all|check]"
+    exit 2
+    ;;
+esac
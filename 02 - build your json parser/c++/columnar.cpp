@@ -0,0 +1,422 @@
+#include "columnar.hpp"
+#include "formatter.hpp"
+#include "output_buffer.hpp"
+#include <cstdio>
+#include <cstdlib>
+
+const Column *ColumnarTable::column(const std::string &name) const
+{
+    auto it = index.find(name);
+    return it == index.end() ? nullptr : &columns[it->second];
+}
+
+// Shortest %g form that reads back as the same double
+static std::string formatNumber(double value)
+{
+    char buffer[32];
+    std::snprintf(buffer, sizeof(buffer), "%.15g", value);
+    if (std::strtod(buffer, nullptr) != value)
+    {
+        std::snprintf(buffer, sizeof(buffer), "%.17g", value);
+    }
+    return buffer;
+}
+
+// Reads the array token by token and appends every member value to its
+// column. filled[c] counts the rows column c holds so far; columns missing
+// from a row are padded with nulls when the row ends.
+class ColumnarBuilder
+{
+private:
+    Lexer lexer;
+    Token currentToken;
+    size_t maxDepth;
+    ColumnarTable table;
+    std::vector<size_t> filled;
+    // Column of each member position in the previous row; rows of the same
+    // shape then find their columns without hashing the key
+    std::vector<size_t> expected;
+    OutputBuffer scratch;
+
+    [[noreturn]] void error(const std::string &msg) const
+    {
+        lexer.errorAt("Parser", currentToken.offset, msg);
+    }
+    void advance() { currentToken = lexer.getNextToken(); }
+
+    size_t columnFor(const std::string &key, size_t member);
+    void readRow();
+    void readValue(size_t c);
+    void append(size_t c, bool isValid);
+    void dropLast(size_t c);
+    void setType(size_t c, ColumnType type);
+    void appendText(size_t c, const char *data, size_t size);
+
+public:
+    ColumnarBuilder(const char *text, size_t length, size_t maxDepth)
+        : lexer(text, length), currentToken(TokenType::INVALID), maxDepth(maxDepth)
+    {
+        advance();
+    }
+
+    ColumnarTable build();
+};
+
+ColumnarTable ColumnarBuilder::build()
+{
+    if (currentToken.type != TokenType::LBRACKET)
+    {
+        error("Expected an array of objects");
+    }
+    advance();
+
+    if (currentToken.type == TokenType::RBRACKET)
+    {
+        advance();
+    }
+    else
+    {
+        while (true)
+        {
+            readRow();
+
+            if (currentToken.type == TokenType::COMMA)
+            {
+                advance();
+                if (currentToken.type == TokenType::RBRACKET)
+                {
+                    error("Trailing comma in array");
+                }
+                continue;
+            }
+            if (currentToken.type != TokenType::RBRACKET)
+            {
+                error("Expected comma or ] in array");
+            }
+            advance();
+            break;
+        }
+    }
+
+    if (currentToken.type != TokenType::EOF_TOKEN)
+    {
+        error("Extra content after JSON value");
+    }
+    return std::move(table);
+}
+
+size_t ColumnarBuilder::columnFor(const std::string &key, size_t member)
+{
+    if (member < expected.size() && table.columns[expected[member]].name == key)
+    {
+        return expected[member];
+    }
+
+    size_t c;
+    auto it = table.index.find(key);
+    if (it != table.index.end())
+    {
+        c = it->second;
+    }
+    else
+    {
+        // New member name: every earlier row is null in it
+        c = table.columns.size();
+        table.index[key] = c;
+        table.columns.push_back(Column());
+        table.columns.back().name = key;
+        filled.push_back(0);
+        while (filled[c] < table.rows)
+        {
+            append(c, false);
+        }
+    }
+
+    if (member >= expected.size())
+    {
+        expected.resize(member + 1);
+    }
+    expected[member] = c;
+    return c;
+}
+
+void ColumnarBuilder::readRow()
+{
+    if (currentToken.type == TokenType::NULL_TOKEN)
+    {
+        advance();
+    }
+    else if (currentToken.type != TokenType::LBRACE)
+    {
+        error("Expected object in array");
+    }
+    else
+    {
+        advance();
+        for (size_t member = 0; currentToken.type != TokenType::RBRACE; member++)
+        {
+            if (currentToken.type != TokenType::STRING)
+            {
+                error("Expected string key in object");
+            }
+            size_t c = columnFor(currentToken.value, member);
+            advance();
+            if (currentToken.type != TokenType::COLON)
+            {
+                error("Expected colon after object key");
+            }
+            advance();
+            readValue(c);
+
+            if (currentToken.type == TokenType::COMMA)
+            {
+                advance();
+                if (currentToken.type == TokenType::RBRACE)
+                {
+                    error("Trailing comma in object");
+                }
+            }
+            else if (currentToken.type != TokenType::RBRACE)
+            {
+                error("Expected comma or } in object");
+            }
+        }
+        advance();
+    }
+
+    // Members this row did not have are null
+    for (size_t c = 0; c < table.columns.size(); c++)
+    {
+        if (filled[c] == table.rows)
+        {
+            append(c, false);
+        }
+    }
+    table.rows++;
+}
+
+void ColumnarBuilder::readValue(size_t c)
+{
+    // A repeated member replaces the value the row already has
+    if (filled[c] > table.rows)
+    {
+        dropLast(c);
+    }
+
+    Column &column = table.columns[c];
+    switch (currentToken.type)
+    {
+    case TokenType::NULL_TOKEN:
+        append(c, false);
+        advance();
+        return;
+    case TokenType::NUMBER:
+    {
+        double number;
+        if (!parseJsonNumber(currentToken.value, number))
+        {
+            error("Number out of range: " + currentToken.value);
+        }
+        setType(c, ColumnType::NUMBER);
+        if (column.type == ColumnType::NUMBER)
+        {
+            column.numbers.push_back(number);
+            append(c, true);
+        }
+        else
+        {
+            appendText(c, currentToken.value.data(), currentToken.value.size());
+        }
+        advance();
+        return;
+    }
+    case TokenType::TRUE:
+    case TokenType::FALSE:
+        setType(c, ColumnType::BOOLEAN);
+        if (column.type == ColumnType::BOOLEAN)
+        {
+            column.booleans.push_back(currentToken.type == TokenType::TRUE);
+            append(c, true);
+        }
+        else
+        {
+            appendText(c, currentToken.value.data(), currentToken.value.size());
+        }
+        advance();
+        return;
+    case TokenType::STRING:
+        setType(c, ColumnType::STRING);
+        if (column.type == ColumnType::STRING)
+        {
+            appendText(c, currentToken.value.data(), currentToken.value.size());
+        }
+        else
+        {
+            scratch.str().clear();
+            writeJsonString(scratch, currentToken.value);
+            appendText(c, scratch.str().data(), scratch.str().size());
+        }
+        advance();
+        return;
+    case TokenType::LBRACE:
+    case TokenType::LBRACKET:
+    {
+        // Nested values are kept as compact JSON text; the Formatter takes
+        // over the Lexer from the opening bracket and hands it back after
+        // the closing one
+        setType(c, ColumnType::JSON);
+        FormatOptions options;
+        options.minify = true;
+        options.maxDepth = maxDepth > 2 ? maxDepth - 2 : 0;
+        scratch.str().clear();
+        lexer.seek(currentToken.offset);
+        Formatter formatter(lexer, scratch, options);
+        formatter.formatValue();
+        currentToken = formatter.token();
+        appendText(c, scratch.str().data(), scratch.str().size());
+        return;
+    }
+    default:
+        error("Unexpected token in value");
+    }
+}
+
+// Records the next row of column c as valid or null. The typed data for
+// valid values is pushed by the caller; nulls get a placeholder here.
+void ColumnarBuilder::append(size_t c, bool isValid)
+{
+    Column &column = table.columns[c];
+    size_t row = filled[c]++;
+
+    if (row % 64 == 0)
+    {
+        column.valid.push_back(0);
+    }
+    if (isValid)
+    {
+        column.valid.back() |= uint64_t(1) << (row % 64);
+        return;
+    }
+
+    switch (column.type)
+    {
+    case ColumnType::NUMBER:
+        column.numbers.push_back(0);
+        break;
+    case ColumnType::BOOLEAN:
+        column.booleans.push_back(0);
+        break;
+    case ColumnType::STRING:
+    case ColumnType::JSON:
+        column.offsets.push_back(column.chars.size());
+        break;
+    case ColumnType::NULL_VALUE:
+        break;
+    }
+}
+
+void ColumnarBuilder::dropLast(size_t c)
+{
+    Column &column = table.columns[c];
+    size_t row = --filled[c];
+
+    column.valid.back() &= ~(uint64_t(1) << (row % 64));
+    if (row % 64 == 0)
+    {
+        column.valid.pop_back();
+    }
+
+    switch (column.type)
+    {
+    case ColumnType::NUMBER:
+        column.numbers.pop_back();
+        break;
+    case ColumnType::BOOLEAN:
+        column.booleans.pop_back();
+        break;
+    case ColumnType::STRING:
+    case ColumnType::JSON:
+        column.offsets.pop_back();
+        column.chars.resize(column.offsets.back());
+        break;
+    case ColumnType::NULL_VALUE:
+        break;
+    }
+}
+
+// Makes column c able to hold a value of type: a column without values takes
+// the type, a column of another type becomes a JSON column
+void ColumnarBuilder::setType(size_t c, ColumnType type)
+{
+    Column &column = table.columns[c];
+    size_t rows = filled[c];
+
+    if (column.type == type || column.type == ColumnType::JSON)
+    {
+        return;
+    }
+
+    if (column.type == ColumnType::NULL_VALUE)
+    {
+        column.type = type;
+        switch (type)
+        {
+        case ColumnType::NUMBER:
+            column.numbers.assign(rows, 0);
+            break;
+        case ColumnType::BOOLEAN:
+            column.booleans.assign(rows, 0);
+            break;
+        default:
+            column.offsets.assign(rows + 1, 0);
+            break;
+        }
+        return;
+    }
+
+    // Rewrite the values held so far as JSON text
+    std::string chars;
+    std::vector<uint64_t> offsets(1, 0);
+    offsets.reserve(rows + 1);
+    for (size_t row = 0; row < rows; row++)
+    {
+        if (!column.isNull(row))
+        {
+            switch (column.type)
+            {
+            case ColumnType::NUMBER:
+                chars += formatNumber(column.numbers[row]);
+                break;
+            case ColumnType::BOOLEAN:
+                chars += column.booleans[row] ? "true" : "false";
+                break;
+            default:
+                scratch.str().clear();
+                writeJsonString(scratch, column.text(row));
+                chars += scratch.str();
+                break;
+            }
+        }
+        offsets.push_back(chars.size());
+    }
+
+    column.type = ColumnType::JSON;
+    column.chars = std::move(chars);
+    column.offsets = std::move(offsets);
+    std::vector<double>().swap(column.numbers);
+    std::vector<uint8_t>().swap(column.booleans);
+}
+
+void ColumnarBuilder::appendText(size_t c, const char *data, size_t size)
+{
+    Column &column = table.columns[c];
+    column.chars.append(data, size);
+    column.offsets.push_back(column.chars.size());
+    append(c, true);
+}
+
+ColumnarTable parseColumnar(const char *text, size_t length, size_t maxDepth)
+{
+    ColumnarBuilder builder(text, length, maxDepth);
+    return builder.build();
+}
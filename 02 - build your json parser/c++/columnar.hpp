@@ -0,0 +1,70 @@
+#pragma once
+#include "json_parser.hpp"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Columnar (struct-of-arrays) form of an array of objects: one column per
+// member name, each holding that member's value for every row in a single
+// contiguous vector. This is much smaller than a JsonObject per row and lets
+// aggregations scan plain arrays of doubles.
+
+enum class ColumnType
+{
+    NULL_VALUE, // no row has a value yet
+    NUMBER,
+    BOOLEAN,
+    STRING,
+    JSON // mixed types, arrays or objects: compact JSON text per row
+};
+
+struct Column
+{
+    std::string name;
+    ColumnType type = ColumnType::NULL_VALUE;
+
+    // Bit (row % 64) of valid[row / 64] is set when the row has a non-null
+    // value; missing members and nulls leave it clear
+    std::vector<uint64_t> valid;
+
+    std::vector<double> numbers;   // NUMBER: one per row, 0 for nulls
+    std::vector<uint8_t> booleans; // BOOLEAN: one per row, 0 for nulls
+
+    // STRING and JSON: row i is chars[offsets[i], offsets[i + 1]), empty
+    // for nulls; offsets has one entry more than there are rows
+    std::string chars;
+    std::vector<uint64_t> offsets;
+
+    bool isNull(size_t row) const { return (valid[row / 64] >> (row % 64) & 1) == 0; }
+    double number(size_t row) const { return numbers[row]; }
+    bool boolean(size_t row) const { return booleans[row] != 0; }
+    // String value, or JSON text for a JSON column
+    std::string text(size_t row) const { return chars.substr(offsets[row], offsets[row + 1] - offsets[row]); }
+};
+
+class ColumnarTable
+{
+public:
+    size_t rows = 0;
+    std::vector<Column> columns; // in order of first appearance
+
+    // Returns the column for a member name, or nullptr if no row has it
+    const Column *column(const std::string &name) const;
+
+private:
+    friend class ColumnarBuilder;
+    std::unordered_map<std::string, size_t> index;
+};
+
+// Parses a JSON array of objects straight into columns, without building
+// JsonValue nodes. The schema is found while reading: a member name seen for
+// the first time adds a column (earlier rows are null in it), and a column
+// that meets a value of a second type turns into a JSON column, with the
+// values it already holds rewritten as JSON text. A duplicate member in a
+// row replaces the earlier one, as with JsonObject::find. null elements are
+// rows whose columns are all null.
+//
+// The whole input is validated; throws ParseError if it is malformed or is
+// not an array of objects.
+ColumnarTable parseColumnar(const char *text, size_t length, size_t maxDepth = Parser::DEFAULT_MAX_DEPTH);
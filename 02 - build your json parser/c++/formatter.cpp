@@ -0,0 +1,248 @@
+#include "formatter.hpp"
+#include <algorithm>
+#include <sstream>
+
+Formatter::Formatter(Lexer &lex, OutputBuffer &output, const FormatOptions &options)
+    : lexer(lex), out(output), options(options), currentToken(TokenType::INVALID)
+{
+    currentToken = lexer.getNextToken();
+}
+
+// Reports msg at the current token
+void Formatter::error(const std::string &msg) const
+{
+    lexer.errorAt("Formatter", currentToken.offset, msg);
+}
+
+void Formatter::advance()
+{
+    currentToken = lexer.getNextToken();
+}
+
+// Output goes to the innermost sorted object, if any
+OutputBuffer &Formatter::sink()
+{
+    return buffers.empty() ? out : *buffers.back();
+}
+
+// Starts a new line indented for depth open containers
+void Formatter::newline(OutputBuffer &target, size_t depth)
+{
+    if (!options.minify)
+    {
+        target.put('\n');
+        target.fill(' ', depth * options.indent);
+    }
+}
+
+void Formatter::format()
+{
+    formatValue();
+    if (currentToken.type != TokenType::EOF_TOKEN)
+    {
+        error("Extra content after JSON value");
+    }
+}
+
+void Formatter::formatValue()
+{
+    stack.clear();
+    buffers.clear();
+
+    while (true)
+    {
+        switch (currentToken.type)
+        {
+        case TokenType::LBRACE:
+            advance();
+            if (currentToken.type == TokenType::RBRACE)
+            {
+                advance();
+                sink().write("{}", 2);
+                break;
+            }
+            openContainer(true);
+            beginMember();
+            continue;
+        case TokenType::LBRACKET:
+            advance();
+            if (currentToken.type == TokenType::RBRACKET)
+            {
+                advance();
+                sink().write("[]", 2);
+                break;
+            }
+            openContainer(false);
+            beginElement();
+            continue;
+        case TokenType::STRING:
+            writeJsonString(sink(), currentToken.value);
+            advance();
+            break;
+        case TokenType::NUMBER:
+        case TokenType::TRUE:
+        case TokenType::FALSE:
+        case TokenType::NULL_TOKEN:
+            // Token text is exactly what was in the input
+            sink().write(currentToken.value);
+            advance();
+            break;
+        default:
+            error("Unexpected token in value");
+        }
+
+        // A value is complete; close finished containers until a comma asks
+        // for the next member or element
+        while (true)
+        {
+            if (stack.empty())
+            {
+                return;
+            }
+
+            Frame &top = stack.back();
+            TokenType closing = top.isObject ? TokenType::RBRACE : TokenType::RBRACKET;
+
+            if (currentToken.type == TokenType::COMMA)
+            {
+                advance();
+                if (currentToken.type == closing)
+                {
+                    error(top.isObject ? "Trailing comma in object" : "Trailing comma in array");
+                }
+                if (top.isObject)
+                {
+                    beginMember();
+                }
+                else
+                {
+                    beginElement();
+                }
+                break;
+            }
+            if (currentToken.type != closing)
+            {
+                error(top.isObject ? "Expected comma or } in object" : "Expected comma or ] in array");
+            }
+
+            advance();
+            closeContainer();
+        }
+    }
+}
+
+void Formatter::openContainer(bool isObject)
+{
+    if (stack.size() >= options.maxDepth)
+    {
+        std::ostringstream oss;
+        oss << "Maximum nesting depth of " << options.maxDepth << " exceeded";
+        error(oss.str());
+    }
+
+    bool sorted = isObject && options.sortKeys;
+    if (sorted)
+    {
+        // The opening brace is written with the sorted members on close
+        buffers.emplace_back(new OutputBuffer());
+    }
+    else
+    {
+        sink().put(isObject ? '{' : '[');
+    }
+    stack.push_back({isObject, sorted, 0, {}});
+}
+
+void Formatter::closeContainer()
+{
+    Frame &top = stack.back();
+    size_t depth = stack.size() - 1;
+
+    if (!top.sorted)
+    {
+        newline(sink(), depth);
+        sink().put(top.isObject ? '}' : ']');
+        stack.pop_back();
+        return;
+    }
+
+    // Write the buffered members in key order; stable so duplicate keys keep
+    // their input order
+    std::unique_ptr<OutputBuffer> members = std::move(buffers.back());
+    buffers.pop_back();
+    const std::string &text = members->str();
+
+    std::vector<size_t> order(top.members.size());
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(),
+                     [&](size_t a, size_t b) { return top.members[a].key < top.members[b].key; });
+
+    OutputBuffer &target = sink();
+    target.put('{');
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        size_t m = order[i];
+        size_t end = m + 1 < top.members.size() ? top.members[m + 1].start : text.size();
+
+        if (i > 0)
+        {
+            target.put(',');
+        }
+        newline(target, depth + 1);
+        writeJsonString(target, top.members[m].key);
+        target.write(options.minify ? ":" : ": ");
+        target.write(text.data() + top.members[m].start, end - top.members[m].start);
+    }
+    newline(target, depth);
+    target.put('}');
+    stack.pop_back();
+}
+
+// Reads `"key" :` and writes everything up to the member's value
+void Formatter::beginMember()
+{
+    if (currentToken.type != TokenType::STRING)
+    {
+        error("Expected string key in object");
+    }
+
+    Frame &top = stack.back();
+    if (top.sorted)
+    {
+        top.members.push_back({std::move(currentToken.value), buffers.back()->str().size()});
+    }
+    else
+    {
+        OutputBuffer &target = sink();
+        if (top.count > 0)
+        {
+            target.put(',');
+        }
+        newline(target, stack.size());
+        writeJsonString(target, currentToken.value);
+        target.write(options.minify ? ":" : ": ");
+    }
+    top.count++;
+    advance();
+
+    if (currentToken.type != TokenType::COLON)
+    {
+        error("Expected colon after object key");
+    }
+    advance();
+}
+
+void Formatter::beginElement()
+{
+    Frame &top = stack.back();
+    OutputBuffer &target = sink();
+    if (top.count > 0)
+    {
+        target.put(',');
+    }
+    newline(target, stack.size());
+    top.count++;
+}
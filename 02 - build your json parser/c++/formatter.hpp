@@ -0,0 +1,73 @@
+#pragma once
+#include "json_parser.hpp"
+#include "output_buffer.hpp"
+#include <memory>
+#include <string>
+#include <vector>
+
+struct FormatOptions
+{
+    bool minify = false;   // no whitespace at all instead of one member per line
+    bool sortKeys = false; // write object members in byte order of their keys
+    int indent = 2;        // spaces per nesting level when not minified
+    size_t maxDepth = Parser::DEFAULT_MAX_DEPTH;
+};
+
+// Reformats JSON straight from the Lexer's tokens into an OutputBuffer,
+// without building JsonValue nodes. Numbers are copied as written and
+// strings are re-escaped, so nothing is lost to double conversion.
+//
+// Memory use does not depend on the size of the document: only one frame per
+// open container is kept. The exception is sortKeys, which has to hold each
+// object's members until the object is closed, so an object is buffered in
+// full (including everything nested in it) before it is written.
+//
+// The input is checked as it is written, so on a ParseError the output stops
+// at the point of the error.
+class Formatter
+{
+private:
+    struct Member
+    {
+        std::string key;
+        size_t start; // where the member's value begins in the object's buffer
+    };
+
+    // An object or array that is still being written
+    struct Frame
+    {
+        bool isObject;
+        bool sorted; // members go to buffers.back() and are written on close
+        size_t count;
+        std::vector<Member> members;
+    };
+
+    Lexer &lexer;
+    OutputBuffer &out;
+    FormatOptions options;
+    Token currentToken;
+    std::vector<Frame> stack;
+    // One in-memory buffer per open sorted object, innermost last
+    std::vector<std::unique_ptr<OutputBuffer>> buffers;
+
+    [[noreturn]] void error(const std::string &msg) const;
+    void advance();
+    OutputBuffer &sink();
+    void newline(OutputBuffer &target, size_t depth);
+    void openContainer(bool isObject);
+    void closeContainer();
+    void beginMember();
+    void beginElement();
+
+public:
+    Formatter(Lexer &lex, OutputBuffer &output, const FormatOptions &options = FormatOptions());
+
+    // Reformats one JSON value; throws ParseError if the input is malformed
+    void format();
+
+    // Reformats the value starting at the Lexer's next token and stops right
+    // after it, so the value can be embedded in a larger document. token()
+    // is then the first token after the value.
+    void formatValue();
+    const Token &token() const { return currentToken; }
+};
@@ -0,0 +1,274 @@
+#include "incremental.hpp"
+#include "structural_scan.hpp"
+#include <stdexcept>
+#include <vector>
+
+static size_t childCount(const JsonValue &value)
+{
+    if (value.type == JsonType::OBJECT)
+    {
+        return static_cast<const JsonObject &>(value).properties.size();
+    }
+    if (value.type == JsonType::ARRAY)
+    {
+        return static_cast<const JsonArray &>(value).elements.size();
+    }
+    return 0;
+}
+
+static JsonPtr &childAt(JsonValue &value, size_t index)
+{
+    if (value.type == JsonType::OBJECT)
+    {
+        return static_cast<JsonObject &>(value).properties[index].second;
+    }
+    return static_cast<JsonArray &>(value).elements[index];
+}
+
+// Lowest set bit of i, the step between Fenwick tree nodes
+static size_t lowBit(size_t i)
+{
+    return i & (~i + 1);
+}
+
+size_t IncrementalDocument::Layout::childOffset(size_t index) const
+{
+    size_t offset = span.childOffsets[index];
+    if (!shifts.empty())
+    {
+        for (size_t i = index + 1; i > 0; i -= lowBit(i))
+        {
+            offset += shifts[i];
+        }
+    }
+    return offset;
+}
+
+void IncrementalDocument::Layout::shiftFrom(size_t first, size_t delta)
+{
+    size_t count = span.childOffsets.size();
+    if (first >= count)
+    {
+        return;
+    }
+    if (shifts.empty())
+    {
+        shifts.assign(count + 1, 0);
+    }
+    for (size_t i = first + 1; i <= count; i += lowBit(i))
+    {
+        shifts[i] += delta;
+    }
+}
+
+// Children are in source order, so their offsets are sorted
+size_t IncrementalDocument::Layout::childBefore(size_t offset) const
+{
+    size_t count = span.childOffsets.size();
+    size_t low = 0;
+    size_t high = count;
+    while (low < high)
+    {
+        size_t mid = low + (high - low) / 2;
+        if (childOffset(mid) < offset)
+        {
+            low = mid + 1;
+        }
+        else
+        {
+            high = mid;
+        }
+    }
+    return low == 0 ? count : low - 1;
+}
+
+IncrementalDocument::IncrementalDocument(std::string json, size_t maxDepth)
+    : source(std::move(json)), maxDepth(maxDepth)
+{
+    parseAll();
+}
+
+void IncrementalDocument::parseAll()
+{
+    SpanTable parsed;
+    Lexer lexer(source.data(), source.size());
+    Parser parser(lexer, maxDepth);
+    parser.setSpanTable(&parsed);
+    tree = parser.parse();
+    reparsed = source.size();
+    rootStart = scanWhitespace(source.data(), source.size(), 0);
+
+    layouts.clear();
+    for (auto &entry : parsed)
+    {
+        layouts[entry.first].span = std::move(entry.second);
+    }
+}
+
+IncrementalDocument::Layout *IncrementalDocument::layoutOf(const JsonValue &value)
+{
+    auto found = layouts.find(&value);
+    return found == layouts.end() ? nullptr : &found->second;
+}
+
+void IncrementalDocument::replaceLayouts(JsonValue &old, SpanTable &parsed)
+{
+    // Forget the old subtree first: its nodes are about to be freed, and
+    // their addresses may be reused by later parses
+    std::vector<JsonValue *> pending{&old};
+    while (!pending.empty())
+    {
+        JsonValue *value = pending.back();
+        pending.pop_back();
+        if (layouts.erase(value) == 0)
+        {
+            continue; // a scalar
+        }
+        for (size_t i = 0; i < childCount(*value); i++)
+        {
+            pending.push_back(childAt(*value, i).get());
+        }
+    }
+    for (auto &entry : parsed)
+    {
+        layouts[entry.first].span = std::move(entry.second);
+    }
+}
+
+size_t IncrementalDocument::spanLength(const JsonValue &container) const
+{
+    return layouts.at(&container).span.length;
+}
+
+size_t IncrementalDocument::childOffset(const JsonValue &container, size_t index) const
+{
+    const Layout &layout = layouts.at(&container);
+    if (index >= layout.span.childOffsets.size())
+    {
+        throw std::out_of_range("Child index is past the end of the container");
+    }
+    return layout.childOffset(index);
+}
+
+void IncrementalDocument::edit(size_t offset, size_t length, const std::string &replacement)
+{
+    if (offset > source.size() || length > source.size() - offset)
+    {
+        throw std::out_of_range("Edit range is outside the document");
+    }
+
+    // The layout of value if it is a container starting at start whose
+    // brackets lie strictly around [offset, offset + length), else nullptr
+    auto holdsEdit = [&](const JsonValue &value, size_t start) -> Layout *
+    {
+        Layout *layout = layoutOf(value);
+        if (layout == nullptr || start >= offset || offset + length >= start + layout->span.length)
+        {
+            return nullptr;
+        }
+        return layout;
+    };
+
+    // Walk down to the innermost container holding the edit, remembering
+    // the way back up
+    struct Step
+    {
+        JsonValue *container;
+        Layout *layout;
+        size_t start; // absolute offset of the container
+        size_t child; // index of the child the walk went into
+    };
+    std::vector<Step> path;
+    JsonValue *node = tree.get();
+    size_t start = rootStart;
+    Layout *layout = holdsEdit(*node, start);
+    bool whole = layout == nullptr;
+
+    while (!whole)
+    {
+        size_t i = layout->childBefore(offset - start);
+        if (i == childCount(*node))
+        {
+            break;
+        }
+        JsonValue &child = *childAt(*node, i);
+        size_t childStart = start + layout->childOffset(i);
+        Layout *childLayout = holdsEdit(child, childStart);
+        if (childLayout == nullptr)
+        {
+            break;
+        }
+        path.push_back({node, layout, start, i});
+        node = &child;
+        layout = childLayout;
+        start = childStart;
+    }
+
+    std::string removed = source.substr(offset, length);
+    source.replace(offset, length, replacement);
+
+    JsonPtr updated;
+    SpanTable parsed;
+    try
+    {
+        while (true)
+        {
+            if (whole)
+            {
+                parseAll();
+                return;
+            }
+
+            // Parse just the container, with offsets that match the whole text
+            size_t newLength = layout->span.length + replacement.size() - length;
+            try
+            {
+                parsed.clear();
+                Lexer lexer(source.data(), start + newLength);
+                lexer.seek(start);
+                Parser parser(lexer, maxDepth - path.size());
+                parser.setSpanTable(&parsed);
+                updated = parser.parse();
+                reparsed = newLength;
+                break;
+            }
+            catch (const ParseError &)
+            {
+                // The edit may have moved the container's own brackets, as
+                // when "],[" splits an array in two; try its parent instead
+                if (path.empty())
+                {
+                    whole = true;
+                }
+                else
+                {
+                    node = path.back().container;
+                    layout = path.back().layout;
+                    start = path.back().start;
+                    path.pop_back();
+                }
+            }
+        }
+    }
+    catch (...)
+    {
+        source.replace(offset, replacement.size(), removed);
+        throw;
+    }
+
+    replaceLayouts(*node, parsed);
+    if (path.empty())
+    {
+        tree = std::move(updated);
+        return;
+    }
+    childAt(*path.back().container, path.back().child) = std::move(updated);
+
+    // Ancestors grow or shrink by the size change, and the children after
+    // the edited one move with it
+    for (const Step &step : path)
+    {
+        step.layout->span.length += replacement.size() - length;
+        step.layout->shiftFrom(step.child + 1, replacement.size() - length);
+    }
+}
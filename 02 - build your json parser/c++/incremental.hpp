@@ -0,0 +1,76 @@
+#pragma once
+#include "json_parser.hpp"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A parsed document that is kept in sync with text edits. The span of every
+// container is recorded while parsing (see Parser::setSpanTable) and kept
+// beside the tree, so an edit can be mapped to the smallest container whose
+// contents it falls inside. Only that container is parsed again and swapped
+// into the tree; if the edit does not leave it a complete value on its own,
+// its parent is tried, and so on up to a parse of the whole text. Child
+// offsets are relative to their container and later moves are kept in a
+// Fenwick tree per container, so an edit updates the containers on the path
+// to it in O(depth * log(width)) rather than touching every later sibling.
+//
+// The tree must not be changed directly; it is only updated by edit().
+class IncrementalDocument
+{
+private:
+    // Recorded span of one container. shifts is a Fenwick tree of how far
+    // its children have moved since (empty until an edit first moves one);
+    // the sums wrap around like the size_t offsets they are added to.
+    struct Layout
+    {
+        ContainerSpan span;
+        std::vector<size_t> shifts;
+
+        size_t childOffset(size_t index) const;
+        // Index of the last child starting before offset (relative to the
+        // container), or the child count if there is none
+        size_t childBefore(size_t offset) const;
+        // Moves the children from index first onward by delta bytes
+        void shiftFrom(size_t first, size_t delta);
+    };
+
+    std::string source;
+    JsonPtr tree;
+    std::unordered_map<const JsonValue *, Layout> layouts;
+    size_t rootStart = 0;
+    size_t maxDepth;
+    size_t reparsed = 0;
+
+    // Full parse of source, used when an edit is not inside the root container
+    void parseAll();
+    // nullptr for a scalar
+    Layout *layoutOf(const JsonValue &value);
+    // Swaps the layouts of the subtree at old for those in parsed
+    void replaceLayouts(JsonValue &old, SpanTable &parsed);
+
+public:
+    explicit IncrementalDocument(std::string json, size_t maxDepth = Parser::DEFAULT_MAX_DEPTH);
+
+    IncrementalDocument(const IncrementalDocument &) = delete;
+    IncrementalDocument &operator=(const IncrementalDocument &) = delete;
+
+    const std::string &text() const { return source; }
+    const JsonPtr &root() const { return tree; }
+
+    // Where values are in text(): the root starts at rootOffset(), a
+    // container of the tree is spanLength() bytes long, and its children
+    // start childOffset() bytes after it. Throws std::out_of_range for a
+    // value that is not a container of the tree, or an index past its end.
+    size_t rootOffset() const { return rootStart; }
+    size_t spanLength(const JsonValue &container) const;
+    size_t childOffset(const JsonValue &container, size_t index) const;
+
+    // Replaces length bytes at offset with replacement and brings the tree
+    // up to date. If the edited text is not valid JSON a ParseError is thrown
+    // and both the text and the tree are left as they were. Throws
+    // std::out_of_range if the range is outside the text.
+    void edit(size_t offset, size_t length, const std::string &replacement);
+
+    // Number of bytes parsed by the last edit (the whole text after a full parse)
+    size_t lastReparsedBytes() const { return reparsed; }
+};
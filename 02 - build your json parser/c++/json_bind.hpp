@@ -0,0 +1,617 @@
+#pragma once
+#include "json_parser.hpp"
+#include "output_buffer.hpp"
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+// Binds C++ structs to JSON without going through JsonValue. Fields are
+// declared once, after the struct, at global scope:
+//
+//     struct Person { std::string name; int age; std::vector<std::string> tags; };
+//     JSON_BIND(Person, name, age, tags)
+//
+//     Person p = fromJson<Person>(text);
+//     std::string out = toJson(p);
+//
+// fromJson reads straight from the Lexer's token stream. Member keys are
+// dispatched through a perfect hash over the field names that is computed at
+// compile time; the values of unknown keys are checked and skipped without
+// building anything. Fields missing from the input, or given as null, keep
+// their current value. Floating point fields that are NaN or infinite are
+// written as null.
+//
+// Supported field types: bool, arithmetic types, std::string, std::vector of
+// a supported type, and other bound structs.
+
+// FNV-1a, usable at compile time for field names and at run time for keys
+constexpr uint64_t jsonBindHash(const char *text, size_t length)
+{
+    uint64_t hash = 14695981039346656037ull;
+    for (size_t i = 0; i < length; i++)
+    {
+        hash ^= static_cast<unsigned char>(text[i]);
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+template <class T, class M>
+struct JsonField
+{
+    const char *name;
+    size_t length;
+    uint64_t hash;
+    M T::*member;
+};
+
+template <class T, class M, size_t N>
+constexpr JsonField<T, M> jsonField(const char (&name)[N], M T::*member)
+{
+    return {name, N - 1, jsonBindHash(name, N - 1), member};
+}
+
+// Perfect hash: the smallest slot count for which every field name hash
+// lands in its own slot
+template <size_t N>
+struct JsonFieldTable
+{
+    static constexpr size_t MAX_SLOTS = N * 8;
+
+    size_t slotCount = 0;
+    size_t slots[MAX_SLOTS] = {}; // field index + 1, 0 marks an empty slot
+};
+
+template <class Tuple, size_t... I>
+constexpr JsonFieldTable<sizeof...(I)> makeJsonFieldTable(const Tuple &fields, std::index_sequence<I...>)
+{
+    const size_t count = sizeof...(I);
+    const uint64_t hashes[] = {std::get<I>(fields).hash...};
+
+    JsonFieldTable<count> table{};
+    for (size_t slotCount = count; slotCount <= JsonFieldTable<count>::MAX_SLOTS; slotCount++)
+    {
+        for (size_t s = 0; s < slotCount; s++)
+        {
+            table.slots[s] = 0;
+        }
+
+        bool collision = false;
+        for (size_t i = 0; i < count && !collision; i++)
+        {
+            size_t slot = hashes[i] % slotCount;
+            collision = table.slots[slot] != 0;
+            table.slots[slot] = i + 1;
+        }
+        if (!collision)
+        {
+            table.slotCount = slotCount;
+            return table;
+        }
+    }
+    return table;
+}
+
+// Specialized by JSON_BIND with a constexpr fields() returning a tuple of
+// JsonField descriptors
+template <class T>
+struct JsonBinding;
+
+template <class...>
+struct JsonVoid
+{
+    using type = void;
+};
+
+// Token cursor over a Lexer with one token of lookahead
+class JsonReader
+{
+private:
+    Lexer &lexer;
+    Token current;
+
+public:
+    explicit JsonReader(Lexer &lex) : lexer(lex), current(lexer.getNextToken()) {}
+
+    const Token &peek() const { return current; }
+
+    // Reports msg at the current token, or at offset
+    [[noreturn]] void error(const std::string &msg) const { lexer.errorAt("Parser", current.offset, msg); }
+    [[noreturn]] void error(const std::string &msg, size_t offset) const { lexer.errorAt("Parser", offset, msg); }
+
+    Token next()
+    {
+        Token token = std::move(current);
+        current = lexer.getNextToken();
+        return token;
+    }
+
+    void expect(TokenType type, const char *what)
+    {
+        if (current.type != type)
+        {
+            error(std::string("Expected ") + what);
+        }
+        current = lexer.getNextToken();
+    }
+
+    // Steps over one value, checking its syntax as the Parser would but
+    // without building anything
+    void skipValue()
+    {
+        std::vector<bool> open; // one entry per container entered, true for objects
+        while (true)
+        {
+            switch (current.type)
+            {
+            case TokenType::LBRACE:
+            case TokenType::LBRACKET:
+            {
+                bool isObject = current.type == TokenType::LBRACE;
+                current = lexer.getNextToken();
+                if (current.type == (isObject ? TokenType::RBRACE : TokenType::RBRACKET))
+                {
+                    current = lexer.getNextToken();
+                    break;
+                }
+                open.push_back(isObject);
+                if (isObject)
+                {
+                    skipKey();
+                }
+                continue;
+            }
+            case TokenType::STRING:
+            case TokenType::NUMBER:
+            case TokenType::TRUE:
+            case TokenType::FALSE:
+            case TokenType::NULL_TOKEN:
+                current = lexer.getNextToken();
+                break;
+            case TokenType::EOF_TOKEN:
+                error("Unexpected end of input");
+            default:
+                error("Unexpected token in value");
+            }
+
+            // A value is complete; close finished containers until a comma
+            // asks for the next member or element
+            while (true)
+            {
+                if (open.empty())
+                {
+                    return;
+                }
+                bool isObject = open.back();
+                if (current.type == TokenType::COMMA)
+                {
+                    current = lexer.getNextToken();
+                    if (isObject)
+                    {
+                        skipKey();
+                    }
+                    break;
+                }
+                if (current.type != (isObject ? TokenType::RBRACE : TokenType::RBRACKET))
+                {
+                    error(isObject ? "Expected comma or } in object" : "Expected comma or ] in array");
+                }
+                current = lexer.getNextToken();
+                open.pop_back();
+            }
+        }
+    }
+
+private:
+    void skipKey()
+    {
+        expect(TokenType::STRING, "string key in object");
+        expect(TokenType::COLON, "colon after object key");
+    }
+};
+
+// Reads and writes one C++ type
+template <class T, class Enable = void>
+struct JsonCodec;
+
+template <>
+struct JsonCodec<bool>
+{
+    static void read(JsonReader &reader, bool &value)
+    {
+        TokenType type = reader.peek().type;
+        if (type != TokenType::TRUE && type != TokenType::FALSE && type != TokenType::NULL_TOKEN)
+        {
+            reader.error("Expected boolean");
+        }
+        if (type != TokenType::NULL_TOKEN)
+        {
+            value = type == TokenType::TRUE;
+        }
+        reader.next();
+    }
+
+    static void write(OutputBuffer &out, bool value) { out.write(value ? "true" : "false"); }
+};
+
+template <class T>
+struct JsonCodec<T, typename std::enable_if<std::is_arithmetic<T>::value>::type>
+{
+    static void read(JsonReader &reader, T &value)
+    {
+        if (reader.peek().type == TokenType::NULL_TOKEN)
+        {
+            reader.next();
+            return;
+        }
+        if (reader.peek().type != TokenType::NUMBER)
+        {
+            reader.error("Expected number");
+        }
+        Token token = reader.next();
+        if (!readNumber(token.value, value, std::is_integral<T>()))
+        {
+            reader.error(std::is_integral<T>::value ? "Number does not fit integer field: " + token.value
+                                                    : "Number out of range: " + token.value,
+                         token.offset);
+        }
+    }
+
+    static void write(OutputBuffer &out, T value) { writeNumber(out, value, std::is_integral<T>()); }
+
+private:
+    static bool readNumber(const std::string &text, T &value, std::true_type)
+    {
+        size_t used = 0;
+        try
+        {
+            readInteger(text, value, used);
+        }
+        catch (const std::out_of_range &)
+        {
+            return false; // past 64 bits
+        }
+        return used == text.size();
+    }
+
+    static void readInteger(const std::string &text, T &value, size_t &used)
+    {
+        if (std::is_signed<T>::value)
+        {
+            long long parsed = std::stoll(text, &used);
+            value = static_cast<T>(parsed);
+            if (static_cast<long long>(value) != parsed)
+            {
+                used = 0;
+            }
+        }
+        else
+        {
+            unsigned long long parsed = text[0] == '-' ? 0 : std::stoull(text, &used);
+            value = static_cast<T>(parsed);
+            if (static_cast<unsigned long long>(value) != parsed)
+            {
+                used = 0;
+            }
+        }
+    }
+
+    static bool readNumber(const std::string &text, T &value, std::false_type)
+    {
+        double parsed;
+        if (!parseJsonNumber(text, parsed) || std::fabs(parsed) > std::numeric_limits<T>::max())
+        {
+            return false;
+        }
+        value = static_cast<T>(parsed);
+        return true;
+    }
+
+    static void writeNumber(OutputBuffer &out, T value, std::true_type)
+    {
+        out.write(std::to_string(value));
+    }
+
+    static void writeNumber(OutputBuffer &out, T value, std::false_type)
+    {
+        // JSON has no NaN or infinity
+        if (!std::isfinite(value))
+        {
+            out.write("null", 4);
+            return;
+        }
+        // Enough significant digits to read back the same value: 9 for a
+        // float, 17 for a double (longer types are written as doubles)
+        const int digits = std::numeric_limits<T>::max_digits10 < 17 ? std::numeric_limits<T>::max_digits10 : 17;
+        char buffer[32];
+        int length = std::snprintf(buffer, sizeof(buffer), "%.*g", digits, static_cast<double>(value));
+        out.write(buffer, static_cast<size_t>(length));
+    }
+};
+
+template <>
+struct JsonCodec<std::string>
+{
+    static void read(JsonReader &reader, std::string &value)
+    {
+        if (reader.peek().type == TokenType::NULL_TOKEN)
+        {
+            reader.next();
+            return;
+        }
+        if (reader.peek().type != TokenType::STRING)
+        {
+            reader.error("Expected string");
+        }
+        value = reader.next().value;
+    }
+
+    static void write(OutputBuffer &out, const std::string &value) { writeJsonString(out, value); }
+};
+
+template <class T>
+struct JsonCodec<std::vector<T>>
+{
+    static void read(JsonReader &reader, std::vector<T> &value)
+    {
+        if (reader.peek().type == TokenType::NULL_TOKEN)
+        {
+            reader.next();
+            return;
+        }
+        reader.expect(TokenType::LBRACKET, "array");
+        value.clear();
+        if (reader.peek().type == TokenType::RBRACKET)
+        {
+            reader.next();
+            return;
+        }
+        while (true)
+        {
+            value.emplace_back();
+            JsonCodec<T>::read(reader, value.back());
+            if (reader.peek().type != TokenType::COMMA)
+            {
+                break;
+            }
+            reader.next();
+        }
+        reader.expect(TokenType::RBRACKET, "comma or ] in array");
+    }
+
+    static void write(OutputBuffer &out, const std::vector<T> &value)
+    {
+        out.put('[');
+        for (size_t i = 0; i < value.size(); i++)
+        {
+            if (i > 0)
+            {
+                out.put(',');
+            }
+            JsonCodec<T>::write(out, value[i]);
+        }
+        out.put(']');
+    }
+};
+
+// Compile-time field list and perfect hash table for a bound struct
+template <class T>
+struct JsonBoundFields
+{
+    using List = decltype(JsonBinding<T>::fields());
+    static constexpr size_t COUNT = std::tuple_size<List>::value;
+
+    static constexpr List list = JsonBinding<T>::fields();
+    static constexpr JsonFieldTable<COUNT> table =
+        makeJsonFieldTable(JsonBinding<T>::fields(), std::make_index_sequence<COUNT>());
+
+    static_assert(table.slotCount != 0, "JSON_BIND: no perfect hash found for these field names");
+
+    // Returns the index of the field named key, or COUNT if there is none
+    static size_t lookup(const std::string &key)
+    {
+        size_t slot = table.slots[jsonBindHash(key.data(), key.size()) % table.slotCount];
+        if (slot == 0 || !nameEquals(slot - 1, key, std::make_index_sequence<COUNT>()))
+        {
+            return COUNT;
+        }
+        return slot - 1;
+    }
+
+    static void readField(size_t field, JsonReader &reader, T &value)
+    {
+        readField(field, reader, value, std::make_index_sequence<COUNT>());
+    }
+
+    static void writeFields(OutputBuffer &out, const T &value)
+    {
+        writeFields(out, value, std::make_index_sequence<COUNT>());
+    }
+
+private:
+    template <size_t I>
+    static void readOne(JsonReader &reader, T &value)
+    {
+        using Member = typename std::remove_reference<decltype(value.*(std::get<I>(list).member))>::type;
+        JsonCodec<Member>::read(reader, value.*(std::get<I>(list).member));
+    }
+
+    template <size_t... I>
+    static bool nameEquals(size_t field, const std::string &key, std::index_sequence<I...>)
+    {
+        static const char *const names[] = {std::get<I>(list).name...};
+        static const size_t lengths[] = {std::get<I>(list).length...};
+        return lengths[field] == key.size() && std::memcmp(names[field], key.data(), key.size()) == 0;
+    }
+
+    template <size_t... I>
+    static void readField(size_t field, JsonReader &reader, T &value, std::index_sequence<I...>)
+    {
+        using ReadFn = void (*)(JsonReader &, T &);
+        static const ReadFn readers[] = {&readOne<I>...};
+        readers[field](reader, value);
+    }
+
+    template <size_t... I>
+    static void writeFields(OutputBuffer &out, const T &value, std::index_sequence<I...>)
+    {
+        // Expands to one write per field, in declaration order
+        int expand[] = {(writeOne<I>(out, value, I == 0), 0)...};
+        (void)expand;
+    }
+
+    template <size_t I>
+    static void writeOne(OutputBuffer &out, const T &value, bool first)
+    {
+        const auto &field = std::get<I>(list);
+        using Member = typename std::remove_cv<
+            typename std::remove_reference<decltype(value.*(field.member))>::type>::type;
+        if (!first)
+        {
+            out.put(',');
+        }
+        out.put('"');
+        out.write(field.name, field.length);
+        out.write("\":", 2);
+        JsonCodec<Member>::write(out, value.*(field.member));
+    }
+};
+
+template <class T>
+constexpr typename JsonBoundFields<T>::List JsonBoundFields<T>::list;
+
+template <class T>
+constexpr JsonFieldTable<JsonBoundFields<T>::COUNT> JsonBoundFields<T>::table;
+
+template <class T>
+struct JsonCodec<T, typename JsonVoid<decltype(JsonBinding<T>::fields())>::type>
+{
+    static void read(JsonReader &reader, T &value)
+    {
+        if (reader.peek().type == TokenType::NULL_TOKEN)
+        {
+            reader.next();
+            return;
+        }
+        reader.expect(TokenType::LBRACE, "object");
+        if (reader.peek().type == TokenType::RBRACE)
+        {
+            reader.next();
+            return;
+        }
+        while (true)
+        {
+            if (reader.peek().type != TokenType::STRING)
+            {
+                reader.error("Expected string key in object");
+            }
+            Token key = reader.next();
+            reader.expect(TokenType::COLON, "colon after object key");
+
+            size_t field = JsonBoundFields<T>::lookup(key.value);
+            if (field == JsonBoundFields<T>::COUNT)
+            {
+                reader.skipValue();
+            }
+            else
+            {
+                JsonBoundFields<T>::readField(field, reader, value);
+            }
+
+            if (reader.peek().type != TokenType::COMMA)
+            {
+                break;
+            }
+            reader.next();
+        }
+        reader.expect(TokenType::RBRACE, "comma or } in object");
+    }
+
+    static void write(OutputBuffer &out, const T &value)
+    {
+        out.put('{');
+        JsonBoundFields<T>::writeFields(out, value);
+        out.put('}');
+    }
+};
+
+// Reads one complete document into value
+template <class T>
+void fromJson(Lexer &lexer, T &value)
+{
+    JsonReader reader(lexer);
+    JsonCodec<T>::read(reader, value);
+    if (reader.peek().type != TokenType::EOF_TOKEN)
+    {
+        reader.error("Extra content after JSON value");
+    }
+}
+
+template <class T>
+T fromJson(const std::string &text)
+{
+    Lexer lexer(text.data(), text.size());
+    T value{};
+    fromJson(lexer, value);
+    return value;
+}
+
+// Writes value as compact JSON
+template <class T>
+void toJson(const T &value, OutputBuffer &out)
+{
+    JsonCodec<T>::write(out, value);
+}
+
+template <class T>
+std::string toJson(const T &value)
+{
+    OutputBuffer out;
+    JsonCodec<T>::write(out, value);
+    return std::move(out.str());
+}
+
+// JSON_BIND(Type, field1, field2, ...) - up to 16 fields
+#define JSON_BIND_EXPAND(x) x
+#define JSON_BIND_CAT_(a, b) a##b
+#define JSON_BIND_CAT(a, b) JSON_BIND_CAT_(a, b)
+#define JSON_BIND_COUNT_(_1, _2, _3, _4, _5, _6, _7, _8, _9, _10, _11, _12, _13, _14, _15, _16, N, ...) N
+#define JSON_BIND_COUNT(...) \
+    JSON_BIND_EXPAND(JSON_BIND_COUNT_(__VA_ARGS__, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1))
+
+#define JSON_BIND_FIELD(T, f) jsonField(#f, &T::f)
+#define JSON_BIND_MAP_1(T, f) JSON_BIND_FIELD(T, f)
+#define JSON_BIND_MAP_2(T, f, ...) JSON_BIND_FIELD(T, f), JSON_BIND_EXPAND(JSON_BIND_MAP_1(T, __VA_ARGS__))
+#define JSON_BIND_MAP_3(T, f, ...) JSON_BIND_FIELD(T, f), JSON_BIND_EXPAND(JSON_BIND_MAP_2(T, __VA_ARGS__))
+#define JSON_BIND_MAP_4(T, f, ...) JSON_BIND_FIELD(T, f), JSON_BIND_EXPAND(JSON_BIND_MAP_3(T, __VA_ARGS__))
+#define JSON_BIND_MAP_5(T, f, ...) JSON_BIND_FIELD(T, f), JSON_BIND_EXPAND(JSON_BIND_MAP_4(T, __VA_ARGS__))
+#define JSON_BIND_MAP_6(T, f, ...) JSON_BIND_FIELD(T, f), JSON_BIND_EXPAND(JSON_BIND_MAP_5(T, __VA_ARGS__))
+#define JSON_BIND_MAP_7(T, f, ...) JSON_BIND_FIELD(T, f), JSON_BIND_EXPAND(JSON_BIND_MAP_6(T, __VA_ARGS__))
+#define JSON_BIND_MAP_8(T, f, ...) JSON_BIND_FIELD(T, f), JSON_BIND_EXPAND(JSON_BIND_MAP_7(T, __VA_ARGS__))
+#define JSON_BIND_MAP_9(T, f, ...) JSON_BIND_FIELD(T, f), JSON_BIND_EXPAND(JSON_BIND_MAP_8(T, __VA_ARGS__))
+#define JSON_BIND_MAP_10(T, f, ...) JSON_BIND_FIELD(T, f), JSON_BIND_EXPAND(JSON_BIND_MAP_9(T, __VA_ARGS__))
+#define JSON_BIND_MAP_11(T, f, ...) JSON_BIND_FIELD(T, f), JSON_BIND_EXPAND(JSON_BIND_MAP_10(T, __VA_ARGS__))
+#define JSON_BIND_MAP_12(T, f, ...) JSON_BIND_FIELD(T, f), JSON_BIND_EXPAND(JSON_BIND_MAP_11(T, __VA_ARGS__))
+#define JSON_BIND_MAP_13(T, f, ...) JSON_BIND_FIELD(T, f), JSON_BIND_EXPAND(JSON_BIND_MAP_12(T, __VA_ARGS__))
+#define JSON_BIND_MAP_14(T, f, ...) JSON_BIND_FIELD(T, f), JSON_BIND_EXPAND(JSON_BIND_MAP_13(T, __VA_ARGS__))
+#define JSON_BIND_MAP_15(T, f, ...) JSON_BIND_FIELD(T, f), JSON_BIND_EXPAND(JSON_BIND_MAP_14(T, __VA_ARGS__))
+#define JSON_BIND_MAP_16(T, f, ...) JSON_BIND_FIELD(T, f), JSON_BIND_EXPAND(JSON_BIND_MAP_15(T, __VA_ARGS__))
+
+#define JSON_BIND(Type, ...)                                                                         \
+    template <>                                                                                      \
+    struct JsonBinding<Type>                                                                         \
+    {                                                                                                \
+        static constexpr auto fields()                                                               \
+        {                                                                                            \
+            return std::make_tuple(                                                                  \
+                JSON_BIND_EXPAND(JSON_BIND_CAT(JSON_BIND_MAP_, JSON_BIND_COUNT(__VA_ARGS__))(Type, __VA_ARGS__))); \
+        }                                                                                            \
+    };
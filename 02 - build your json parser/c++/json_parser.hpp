@@ -1,7 +1,13 @@
 #pragma once
+#include <cstdint>
+#include <cstring>
 #include <string>
 #include <vector>
 #include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
 
 // Token types for JSON
 enum class TokenType
@@ -25,55 +31,233 @@ struct Token
 {
     TokenType type;
     std::string value;
+    size_t offset; // byte offset of the token's first character
 
-    Token(TokenType t, const std::string &v = "") : type(t), value(v) {}
+    Token(TokenType t, const std::string &v = "", size_t off = 0) : type(t), value(v), offset(off) {}
 };
 
+// Thrown for malformed input. Only the byte offset is tracked while lexing;
+// line and column are worked out from it when the error is raised.
+class ParseError : public std::runtime_error
+{
+public:
+    size_t offset;
+    size_t line;   // 1-based
+    size_t column; // 1-based, in bytes
+
+    ParseError(const std::string &msg, size_t off, size_t ln, size_t col)
+        : std::runtime_error(msg), offset(off), line(ln), column(col) {}
+};
+
+class OutputBuffer;
+
 // Forward declaration for JSON values
 class JsonValue;
 using JsonPtr = std::shared_ptr<JsonValue>;
 
+// Thread-safe set of distinct strings, meant to be shared by every parser in
+// a batch of documents so that each distinct object key is stored once.
+// Interned strings live as long as the table, so it must outlive every
+// document whose keys point into it.
+class InternTable
+{
+private:
+    static const size_t SHARD_COUNT = 16;
+
+    // Independent locks so parsers on different threads rarely contend;
+    // padded so neighbouring shards do not share a cache line
+    struct Shard
+    {
+        std::mutex mutex;
+        std::unordered_set<std::string> strings;
+        char padding[64];
+    };
+
+    Shard shards[SHARD_COUNT];
+
+public:
+    // Returns the table's copy of text; equal strings give the same pointer
+    const std::string *intern(const std::string &text);
+    size_t size();
+};
+
+// Object member key, 32 bytes like a std::string whatever it holds. Keys of
+// up to 16 bytes are stored inline, longer ones in a heap copy, and interned
+// keys only point into their InternTable, so interning saves memory only for
+// keys longer than 16 bytes.
+//
+// Two interned keys are compared by pointer, which is only right if they
+// come from the same table; compare data() and size() for keys that may not.
+class JsonKey
+{
+private:
+    enum Kind : uint8_t
+    {
+        INLINE,
+        HEAP,
+        INTERNED
+    };
+    static const size_t INLINE_SIZE = 16;
+
+    union
+    {
+        char small[INLINE_SIZE];
+        char *heap;
+        const std::string *interned;
+    };
+    size_t length = 0;
+    Kind kind = INLINE;
+
+    void assign(const char *text, size_t size);
+    void release();
+
+public:
+    JsonKey() {}
+    JsonKey(const std::string &key) { assign(key.data(), key.size()); }
+    JsonKey(const char *key) { assign(key, std::strlen(key)); }
+    explicit JsonKey(const std::string *internedKey) : interned(internedKey), length(internedKey->size()), kind(INTERNED) {}
+    JsonKey(const JsonKey &other);
+    JsonKey(JsonKey &&other) noexcept;
+    JsonKey &operator=(const JsonKey &other);
+    JsonKey &operator=(JsonKey &&other) noexcept;
+    ~JsonKey() { release(); }
+
+    const char *data() const
+    {
+        return kind == INLINE ? small : kind == HEAP ? heap : interned->data();
+    }
+    size_t size() const { return length; }
+    std::string str() const { return std::string(data(), length); }
+    bool isInterned() const { return kind == INTERNED; }
+
+    bool operator==(const JsonKey &other) const
+    {
+        if (kind == INTERNED && other.kind == INTERNED)
+        {
+            return interned == other.interned;
+        }
+        return length == other.length && std::memcmp(data(), other.data(), length) == 0;
+    }
+    bool operator!=(const JsonKey &other) const { return !(*this == other); }
+    bool operator==(const std::string &other) const
+    {
+        return length == other.size() && std::memcmp(data(), other.data(), length) == 0;
+    }
+    bool operator!=(const std::string &other) const { return !(*this == other); }
+    // Byte order, as std::string compares
+    bool operator<(const JsonKey &other) const
+    {
+        int c = std::memcmp(data(), other.data(), length < other.length ? length : other.length);
+        return c < 0 || (c == 0 && length < other.length);
+    }
+};
+
 // Lexer class - converts text to tokens
 class Lexer
 {
 private:
-    std::string text;
+    std::string storage; // copy of the input when constructed from a string
+    const char *text;
+    size_t length;
     size_t pos;
-    size_t line;
-    size_t column;
     char currentChar;
 
     void advance();
     void skipWhitespace();
     std::string parseString();
+    unsigned parseHexQuad();
     std::string parseNumber();
     std::string parseKeyword();
-    void error(const std::string &msg);
+    [[noreturn]] void error(const std::string &msg) const;
 
 public:
     explicit Lexer(const std::string &input);
+    // Lexes data in place (e.g. a memory-mapped file); the caller keeps it
+    // alive for the lifetime of the Lexer
+    Lexer(const char *data, size_t size);
     Token getNextToken();
+
+    // Continues lexing at offset, e.g. after the caller stepped over a value
+    // with scanValue (see structural_scan.hpp)
+    void seek(size_t offset);
+    // Offset just past the last token returned
+    size_t position() const { return pos; }
+
+    // Converts a byte offset into a 1-based line and column by counting the
+    // newlines before it
+    void positionOf(size_t offset, size_t &line, size_t &column) const;
+    // Throws a ParseError such as "<stage> error at line 2, column 5: msg"
+    [[noreturn]] void errorAt(const char *stage, size_t offset, const std::string &msg) const;
+};
+
+// Where a container was in the source, as recorded by Parser::setSpanTable
+struct ContainerSpan
+{
+    size_t length;                    // from the opening bracket to just past the closing one
+    std::vector<size_t> childOffsets; // start of each child, relative to the opening bracket
 };
+using SpanTable = std::unordered_map<const JsonValue *, ContainerSpan>;
 
 // Parser class - converts tokens to JSON structure
+// Containers are tracked on an explicit stack instead of the call stack, so
+// nesting depth is bounded by maxDepth rather than by the size of the thread's
+// stack. The stack is kept between parse() calls to reuse its allocation.
 class Parser
 {
+public:
+    static const size_t DEFAULT_MAX_DEPTH = 512;
+
 private:
+    // An object or array that is still being filled
+    struct Frame
+    {
+        JsonPtr container;
+        JsonKey key; // pending member key when container is an object
+        bool isObject;
+        size_t start;                     // offset of the opening bracket
+        std::vector<size_t> childOffsets; // only filled in when recording spans
+    };
+
     Lexer &lexer;
     Token currentToken;
+    size_t maxDepth;
+    std::vector<Frame> stack;
+    InternTable *keyTable = nullptr;
+    bool buildTree = true;
+    SpanTable *spans = nullptr;
+    size_t tokensRead = 0;
+    size_t valuesRead = 0;
 
+    [[noreturn]] void error(const std::string &msg) const;
     void checkToken(TokenType expected);
     JsonPtr parseValue();
-    JsonPtr parseObject();
-    JsonPtr parseArray();
+    void pushContainer(JsonPtr container, bool isObject, size_t start);
+    void recordSpan(const JsonPtr &container, size_t start, size_t end, std::vector<size_t> childOffsets);
+    void parseKey();
+    JsonPtr skipScalar();
+    double numberValue() const;
     JsonPtr parseString();
     JsonPtr parseNumber();
     JsonPtr parseBoolean();
     JsonPtr parseNull();
 
 public:
-    explicit Parser(Lexer &lex);
+    explicit Parser(Lexer &lex, size_t maxDepth = DEFAULT_MAX_DEPTH);
     JsonPtr parse();
+    // Checks that the input is one well-formed JSON value without building it
+    void validate();
+
+    // Intern object keys in table (nullptr turns interning off again)
+    void setInternTable(InternTable *table) { keyTable = table; }
+
+    // Record the span of every container parse() builds in table, as needed
+    // by IncrementalDocument (nullptr turns recording off again). Entries are
+    // added to what the table already holds.
+    void setSpanTable(SpanTable *table) { spans = table; }
+
+    // Tokens and values (scalars and containers) read so far, for profiling
+    size_t tokenCount() const { return tokensRead; }
+    size_t nodeCount() const { return valuesRead; }
 };
 
 // JSON Value types
@@ -96,16 +280,41 @@ public:
     explicit JsonValue(JsonType t) : type(t) {}
     virtual ~JsonValue() = default;
     virtual std::string toString(int indent = 0) const = 0;
+
+    // Same output as toString, streamed into out instead of built in memory
+    void write(OutputBuffer &out, int indent = 0) const;
 };
 
 // Specific JSON value types
 class JsonObject : public JsonValue
 {
 public:
-    std::vector<std::pair<std::string, JsonPtr>> properties;
+    // Objects with at least this many members get a hash index on first lookup
+    static const size_t INDEX_THRESHOLD = 16;
+
+    std::vector<std::pair<JsonKey, JsonPtr>> properties;
 
     JsonObject() : JsonValue(JsonType::OBJECT) {}
+    ~JsonObject() override;
     std::string toString(int indent = 0) const override;
+
+    // Returns the value of the last member named key (later duplicates win,
+    // as in JSON.parse), or nullptr if there is none. Members appended to
+    // properties are picked up automatically; call invalidateIndex() after
+    // erasing, reordering or renaming members.
+    JsonPtr find(const std::string &key) const;
+
+    // find() builds the index lazily, so call this first when the object will
+    // be queried from several threads at once
+    void buildIndex() const;
+    void invalidateIndex() const;
+
+private:
+    // Open addressing table of member positions + 1 (0 marks an empty slot)
+    mutable std::vector<size_t> index;
+    mutable size_t indexedCount = 0;
+
+    void indexMember(size_t pos) const;
 };
 
 class JsonArray : public JsonValue
@@ -114,6 +323,7 @@ public:
     std::vector<JsonPtr> elements;
 
     JsonArray() : JsonValue(JsonType::ARRAY) {}
+    ~JsonArray() override;
     std::string toString(int indent = 0) const override;
 };
 
@@ -150,3 +360,16 @@ public:
     JsonNull() : JsonValue(JsonType::NULL_VALUE) {}
     std::string toString(int indent = 0) const override;
 };
+
+// Writes value as a quoted JSON string literal, escaping quotes, backslashes
+// and control characters
+void writeJsonString(OutputBuffer &out, const char *data, size_t size);
+inline void writeJsonString(OutputBuffer &out, const std::string &value)
+{
+    writeJsonString(out, value.data(), value.size());
+}
+
+// Converts the text of a NUMBER token. Returns false only if the number is
+// too large for a double; numbers too small for one are rounded to the
+// nearest double (a denormal or zero), as JSON allows.
+bool parseJsonNumber(const std::string &text, double &value);
@@ -0,0 +1,278 @@
+#include "lazy_document.hpp"
+#include "structural_scan.hpp"
+#include <cstring>
+#include <stdexcept>
+
+// Parses an RFC 6901 array index: "0" or digits without a leading zero
+static bool parseIndex(const std::string &token, size_t &index)
+{
+    if (token.empty() || (token.size() > 1 && token[0] == '0'))
+    {
+        return false;
+    }
+    index = 0;
+    for (char c : token)
+    {
+        if (c < '0' || c > '9')
+        {
+            return false;
+        }
+        index = index * 10 + (c - '0');
+    }
+    return true;
+}
+
+// LazyValue implementation
+JsonType LazyValue::type() const
+{
+    switch (text[offset])
+    {
+    case '{':
+        return JsonType::OBJECT;
+    case '[':
+        return JsonType::ARRAY;
+    case '"':
+        return JsonType::STRING;
+    case 't':
+    case 'f':
+        return JsonType::BOOLEAN;
+    case 'n':
+        return JsonType::NULL_VALUE;
+    default:
+        return JsonType::NUMBER;
+    }
+}
+
+size_t LazyValue::endOffset() const
+{
+    return scanValue(text, length, offset);
+}
+
+LazyValue LazyValue::get(const std::string &key) const
+{
+    if (!*this || text[offset] != '{')
+    {
+        return LazyValue();
+    }
+
+    // Every member has to be looked at, since a later one may repeat the name
+    LazyValue found;
+    size_t pos = scanWhitespace(text, length, offset + 1);
+    while (pos < length && text[pos] == '"')
+    {
+        size_t keyEnd = scanString(text, length, pos);
+        bool match = stringLiteralEquals(text, pos, keyEnd, key);
+
+        // Step over the colon to the value
+        pos = scanWhitespace(text, length, keyEnd);
+        pos = scanWhitespace(text, length, pos + 1);
+        if (match)
+        {
+            found = LazyValue(text, length, pos, maxDepth);
+        }
+
+        // Skip the value and the comma after it
+        pos = scanWhitespace(text, length, scanValue(text, length, pos));
+        if (pos < length && text[pos] == ',')
+        {
+            pos = scanWhitespace(text, length, pos + 1);
+        }
+    }
+    return found;
+}
+
+LazyValue LazyValue::get(size_t index) const
+{
+    if (!*this || text[offset] != '[')
+    {
+        return LazyValue();
+    }
+
+    for (Iterator it = begin(), last = end(); it != last; ++it)
+    {
+        if (index-- == 0)
+        {
+            return it->value;
+        }
+    }
+    return LazyValue();
+}
+
+LazyValue LazyValue::at(const std::string &pointer) const
+{
+    if (pointer.empty())
+    {
+        return *this;
+    }
+    if (pointer[0] != '/')
+    {
+        throw std::runtime_error("JSON Pointer must start with '/': " + pointer);
+    }
+
+    LazyValue current = *this;
+    size_t start = 1;
+    while (current)
+    {
+        size_t slash = pointer.find('/', start);
+        std::string token = pointer.substr(start, slash == std::string::npos ? std::string::npos : slash - start);
+
+        // Unescape ~1 to '/' and ~0 to '~', in that order
+        std::string unescaped;
+        for (size_t i = 0; i < token.size(); i++)
+        {
+            if (token[i] == '~' && i + 1 < token.size() && (token[i + 1] == '0' || token[i + 1] == '1'))
+            {
+                unescaped += token[i + 1] == '0' ? '~' : '/';
+                i++;
+            }
+            else
+            {
+                unescaped += token[i];
+            }
+        }
+
+        size_t index;
+        if (current.type() == JsonType::OBJECT)
+        {
+            current = current.get(unescaped);
+        }
+        else if (current.type() == JsonType::ARRAY && parseIndex(unescaped, index))
+        {
+            current = current.get(index);
+        }
+        else
+        {
+            return LazyValue();
+        }
+
+        if (slash == std::string::npos)
+        {
+            break;
+        }
+        start = slash + 1;
+    }
+    return current;
+}
+
+LazyValue::Iterator LazyValue::begin() const
+{
+    Iterator it;
+    it.text = text;
+    it.length = length;
+    it.pos = length;
+    it.maxDepth = maxDepth;
+
+    if (*this && (text[offset] == '{' || text[offset] == '['))
+    {
+        it.isObject = text[offset] == '{';
+        size_t first = scanWhitespace(text, length, offset + 1);
+        if (first < length && text[first] != '}' && text[first] != ']')
+        {
+            it.pos = first;
+            it.load();
+        }
+    }
+    return it;
+}
+
+LazyValue::Iterator LazyValue::end() const
+{
+    Iterator it;
+    it.text = text;
+    it.length = length;
+    it.pos = length;
+    return it;
+}
+
+std::string LazyValue::asString() const
+{
+    if (!*this || type() != JsonType::STRING)
+    {
+        throw std::runtime_error("JSON value is not a string");
+    }
+    return decodeStringLiteral(text, offset, endOffset());
+}
+
+double LazyValue::asNumber() const
+{
+    if (!*this || type() != JsonType::NUMBER)
+    {
+        throw std::runtime_error("JSON value is not a number");
+    }
+    // The document was validated with the same range rule, so this holds
+    double value = 0;
+    parseJsonNumber(raw(), value);
+    return value;
+}
+
+bool LazyValue::asBool() const
+{
+    if (!*this || type() != JsonType::BOOLEAN)
+    {
+        throw std::runtime_error("JSON value is not a boolean");
+    }
+    return text[offset] == 't';
+}
+
+std::string LazyValue::raw() const
+{
+    if (!*this)
+    {
+        return "";
+    }
+    return std::string(text + offset, endOffset() - offset);
+}
+
+JsonPtr LazyValue::parse() const
+{
+    Lexer lexer(text + offset, endOffset() - offset);
+    Parser parser(lexer, maxDepth);
+    return parser.parse();
+}
+
+// LazyValue::Iterator implementation
+void LazyValue::Iterator::load()
+{
+    size_t valueStart = pos;
+    if (isObject)
+    {
+        size_t keyEnd = scanString(text, length, pos);
+        current.key = decodeStringLiteral(text, pos, keyEnd);
+
+        // Step over the colon to the value
+        valueStart = scanWhitespace(text, length, keyEnd);
+        valueStart = scanWhitespace(text, length, valueStart + 1);
+    }
+    current.value = LazyValue(text, length, valueStart, maxDepth);
+}
+
+LazyValue::Iterator &LazyValue::Iterator::operator++()
+{
+    // Skip the current value; a comma means another child follows
+    size_t next = scanWhitespace(text, length, current.value.endOffset());
+    if (next < length && text[next] == ',')
+    {
+        pos = scanWhitespace(text, length, next + 1);
+        load();
+    }
+    else
+    {
+        pos = length;
+    }
+    return *this;
+}
+
+// LazyDocument implementation
+LazyDocument::LazyDocument(std::string json, size_t maxDepth) : text(std::move(json)), maxDepth(maxDepth)
+{
+    Lexer lexer(text.data(), text.size());
+    Parser parser(lexer, maxDepth);
+    parser.validate();
+
+    rootOffset = scanWhitespace(text.data(), text.size(), 0);
+}
+
+LazyValue LazyDocument::root() const
+{
+    return LazyValue(text.data(), text.size(), rootOffset, maxDepth);
+}
@@ -0,0 +1,106 @@
+#pragma once
+#include "json_parser.hpp"
+#include <string>
+
+// On-demand access to a JSON document. The text is validated once up front;
+// after that, objects and arrays are only looked at when navigated into, and
+// subtrees that are stepped over cost a bracket-matching scan (see
+// structural_scan.hpp) instead of a full parse.
+
+// Handle to one value inside a LazyDocument. Handles are cheap to copy and
+// stay valid as long as their document. A default constructed handle, or the
+// result of a failed lookup, is "missing" and converts to false.
+class LazyValue
+{
+public:
+    class Iterator;
+
+    LazyValue() = default;
+
+    explicit operator bool() const { return text != nullptr; }
+    JsonType type() const;
+
+    // Child lookup; returns a missing handle if there is no such child. If an
+    // object repeats a name the last member wins, as in JsonObject::find.
+    LazyValue get(const std::string &key) const;
+    LazyValue get(size_t index) const;
+
+    // RFC 6901 JSON Pointer relative to this value, e.g. "/a/0/b"
+    LazyValue at(const std::string &pointer) const;
+
+    // Iterates the members of an object or the elements of an array
+    Iterator begin() const;
+    Iterator end() const;
+
+    // Scalar accessors; throw if the value has another type
+    std::string asString() const;
+    double asNumber() const;
+    bool asBool() const;
+
+    // Source text of this value
+    std::string raw() const;
+    // Fully parses this value into a JsonValue tree, with the nesting limit
+    // the document was validated with
+    JsonPtr parse() const;
+
+private:
+    friend class LazyDocument;
+
+    const char *text = nullptr;
+    size_t length = 0;
+    size_t offset = 0; // first byte of the value
+    size_t maxDepth = Parser::DEFAULT_MAX_DEPTH;
+
+    LazyValue(const char *text, size_t length, size_t offset, size_t maxDepth)
+        : text(text), length(length), offset(offset), maxDepth(maxDepth) {}
+
+    size_t endOffset() const;
+};
+
+// One child reached while iterating; key is empty for array elements
+struct LazyMember
+{
+    std::string key;
+    LazyValue value;
+};
+
+class LazyValue::Iterator
+{
+public:
+    const LazyMember &operator*() const { return current; }
+    const LazyMember *operator->() const { return &current; }
+    Iterator &operator++();
+    bool operator==(const Iterator &other) const { return pos == other.pos; }
+    bool operator!=(const Iterator &other) const { return pos != other.pos; }
+
+private:
+    friend class LazyValue;
+
+    const char *text = nullptr;
+    size_t length = 0;
+    size_t pos = 0; // start of the current child, or length when done
+    size_t maxDepth = Parser::DEFAULT_MAX_DEPTH;
+    bool isObject = false;
+    LazyMember current;
+
+    void load();
+};
+
+class LazyDocument
+{
+private:
+    std::string text;
+    size_t rootOffset;
+    size_t maxDepth;
+
+public:
+    // Validates json and throws std::runtime_error if it is malformed
+    explicit LazyDocument(std::string json, size_t maxDepth = Parser::DEFAULT_MAX_DEPTH);
+
+    // Handles point into the document's text, so it must stay in place
+    LazyDocument(const LazyDocument &) = delete;
+    LazyDocument &operator=(const LazyDocument &) = delete;
+
+    LazyValue root() const;
+    LazyValue at(const std::string &pointer) const { return root().at(pointer); }
+};
@@ -3,36 +3,129 @@
 #include <stdexcept>
 #include <sstream>
 #include <cctype>
+#include <cstring>
 #include <iomanip>
 
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
 // Lexer implementation
-Lexer::Lexer(const std::string &input) : text(input), pos(0), line(1), column(1)
+Lexer::Lexer(const std::string &input)
+    : storage(input), text(storage.data()), length(storage.size()), pos(0)
 {
-    currentChar = pos < text.length() ? text[pos] : '\0';
+    currentChar = pos < length ? text[pos] : '\0';
 }
 
+Lexer::Lexer(const char *data, size_t size) : text(data), length(size), pos(0)
+{
+    currentChar = pos < length ? text[pos] : '\0';
+}
+
+void Lexer::seek(size_t offset)
+{
+    pos = offset < length ? offset : length;
+    currentChar = pos < length ? text[pos] : '\0';
+}
+
+// Only the byte offset moves here; line and column are derived from it when
+// an error is reported (see positionOf)
 void Lexer::advance()
 {
-    if (currentChar == '\n')
+    pos++;
+    currentChar = pos < length ? text[pos] : '\0';
+}
+
+void Lexer::skipWhitespace()
+{
+    while (currentChar != '\0' && std::isspace(currentChar))
     {
-        line++;
-        column = 1;
+        advance();
     }
-    else
+}
+
+// Returns the offset of the first byte at or after pos that ends a plain run
+// inside a string literal: a quote, a backslash or a control character
+static size_t findStringSpecial(const char *text, size_t pos, size_t length)
+{
+#if defined(__SSE2__) && (defined(__GNUC__) || defined(__clang__))
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i maxControl = _mm_set1_epi8(0x1F);
+
+    // 16 bytes per step; a byte is a control character when the unsigned
+    // minimum with 0x1F leaves it unchanged
+    while (pos + 16 <= length)
     {
-        column++;
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(text + pos));
+        __m128i special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+            _mm_cmpeq_epi8(_mm_min_epu8(chunk, maxControl), chunk));
+        int mask = _mm_movemask_epi8(special);
+        if (mask != 0)
+        {
+            return pos + __builtin_ctz(static_cast<unsigned>(mask));
+        }
+        pos += 16;
     }
+#endif
 
-    pos++;
-    currentChar = pos < text.length() ? text[pos] : '\0';
+    while (pos < length)
+    {
+        unsigned char c = static_cast<unsigned char>(text[pos]);
+        if (c == '"' || c == '\\' || c < 0x20)
+        {
+            break;
+        }
+        pos++;
+    }
+    return pos;
 }
 
-void Lexer::skipWhitespace()
+static void appendUtf8(std::string &out, unsigned codePoint)
 {
-    while (currentChar != '\0' && std::isspace(currentChar))
+    if (codePoint < 0x80)
+    {
+        out += static_cast<char>(codePoint);
+    }
+    else if (codePoint < 0x800)
+    {
+        out += static_cast<char>(0xC0 | (codePoint >> 6));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    else if (codePoint < 0x10000)
+    {
+        out += static_cast<char>(0xE0 | (codePoint >> 12));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+    else
+    {
+        out += static_cast<char>(0xF0 | (codePoint >> 18));
+        out += static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F));
+        out += static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F));
+        out += static_cast<char>(0x80 | (codePoint & 0x3F));
+    }
+}
+
+// Reads the four hex digits after a \u; currentChar must be the 'u' and is
+// left on the last digit
+unsigned Lexer::parseHexQuad()
+{
+    unsigned value = 0;
+    for (int i = 0; i < 4; i++)
     {
         advance();
+        if (!std::isxdigit(static_cast<unsigned char>(currentChar)))
+        {
+            error("Invalid unicode escape");
+        }
+        int digit = std::isdigit(static_cast<unsigned char>(currentChar))
+                        ? currentChar - '0'
+                        : std::tolower(static_cast<unsigned char>(currentChar)) - 'a' + 10;
+        value = (value << 4) | static_cast<unsigned>(digit);
     }
+    return value;
 }
 
 std::string Lexer::parseString()
@@ -40,12 +133,28 @@ std::string Lexer::parseString()
     std::string result = "";
     advance(); // Skip opening quote
 
-    while (currentChar != '\0' && currentChar != '"')
+    while (true)
     {
+        // Copy the run of plain characters up to the next quote, backslash or
+        // control character in one go
+        size_t runEnd = findStringSpecial(text, pos, length);
+        result.append(text + pos, runEnd - pos);
+        pos = runEnd;
+        currentChar = pos < length ? text[pos] : '\0';
+
+        if (pos >= length)
+        {
+            error("Unterminated string");
+        }
+        if (currentChar == '"')
+        {
+            break;
+        }
+
         if (currentChar == '\\')
         {
             advance(); // Skip backslash
-            if (currentChar == '\0')
+            if (pos >= length)
             {
                 error("Unterminated string escape");
             }
@@ -77,17 +186,45 @@ std::string Lexer::parseString()
             case 't':
                 result += '\t';
                 break;
-            case 'u':            // Unicode escape - simplified
-                result += "\\u"; // Keep as-is for simplicity
+            case 'u':
+            {
+                unsigned codePoint = parseHexQuad();
+
+                // Characters outside the BMP come as a UTF-16 surrogate pair
+                if (codePoint >= 0xD800 && codePoint <= 0xDBFF)
+                {
+                    advance();
+                    if (currentChar != '\\')
+                    {
+                        error("Unpaired high surrogate in unicode escape");
+                    }
+                    advance();
+                    if (currentChar != 'u')
+                    {
+                        error("Unpaired high surrogate in unicode escape");
+                    }
+                    unsigned low = parseHexQuad();
+                    if (low < 0xDC00 || low > 0xDFFF)
+                    {
+                        error("Invalid low surrogate in unicode escape");
+                    }
+                    codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+                }
+                else if (codePoint >= 0xDC00 && codePoint <= 0xDFFF)
+                {
+                    error("Unpaired low surrogate in unicode escape");
+                }
+                appendUtf8(result, codePoint);
                 break;
+            }
             default:
                 error("Invalid escape sequence");
             }
         }
         else
         {
-            // Check for control characters
-            if (currentChar < 32 && currentChar != '\t')
+            // Only control characters are left; tabs are tolerated
+            if (currentChar != '\t')
             {
                 error("Control character in string");
             }
@@ -96,11 +233,6 @@ std::string Lexer::parseString()
         advance();
     }
 
-    if (currentChar != '"')
-    {
-        error("Unterminated string");
-    }
-
     advance(); // Skip closing quote
     return result;
 }
@@ -198,11 +330,39 @@ std::string Lexer::parseKeyword()
     return result;
 }
 
-void Lexer::error(const std::string &msg)
+void Lexer::error(const std::string &msg) const
 {
+    errorAt("Lexer", pos, msg);
+}
+
+void Lexer::positionOf(size_t offset, size_t &line, size_t &column) const
+{
+    if (offset > length)
+    {
+        offset = length;
+    }
+
+    line = 1;
+    size_t lineStart = 0;
+    const char *cursor = text;
+    const char *end = text + offset;
+    while (const void *found = std::memchr(cursor, '\n', end - cursor))
+    {
+        cursor = static_cast<const char *>(found) + 1;
+        lineStart = cursor - text;
+        line++;
+    }
+    column = offset - lineStart + 1;
+}
+
+void Lexer::errorAt(const char *stage, size_t offset, const std::string &msg) const
+{
+    size_t line, column;
+    positionOf(offset, line, column);
+
     std::ostringstream oss;
-    oss << "Lexer error at line " << line << ", column " << column << ": " << msg;
-    throw std::runtime_error(oss.str());
+    oss << stage << " error at line " << line << ", column " << column << ": " << msg;
+    throw ParseError(oss.str(), offset, line, column);
 }
 
 Token Lexer::getNextToken()
@@ -215,30 +375,31 @@ Token Lexer::getNextToken()
             continue;
         }
 
+        size_t start = pos;
         switch (currentChar)
         {
         case '{':
             advance();
-            return Token(TokenType::LBRACE, "{");
+            return Token(TokenType::LBRACE, "{", start);
         case '}':
             advance();
-            return Token(TokenType::RBRACE, "}");
+            return Token(TokenType::RBRACE, "}", start);
         case '[':
             advance();
-            return Token(TokenType::LBRACKET, "[");
+            return Token(TokenType::LBRACKET, "[", start);
         case ']':
             advance();
-            return Token(TokenType::RBRACKET, "]");
+            return Token(TokenType::RBRACKET, "]", start);
         case ',':
             advance();
-            return Token(TokenType::COMMA, ",");
+            return Token(TokenType::COMMA, ",", start);
         case ':':
             advance();
-            return Token(TokenType::COLON, ":");
+            return Token(TokenType::COLON, ":", start);
         case '"':
         {
             std::string str = parseString();
-            return Token(TokenType::STRING, str);
+            return Token(TokenType::STRING, str, start);
         }
         case '-':
         case '0':
@@ -253,7 +414,7 @@ Token Lexer::getNextToken()
         case '9':
         {
             std::string num = parseNumber();
-            return Token(TokenType::NUMBER, num);
+            return Token(TokenType::NUMBER, num, start);
         }
         case 't':
         case 'f':
@@ -262,15 +423,15 @@ Token Lexer::getNextToken()
             std::string keyword = parseKeyword();
             if (keyword == "true")
             {
-                return Token(TokenType::TRUE, "true");
+                return Token(TokenType::TRUE, "true", start);
             }
             else if (keyword == "false")
             {
-                return Token(TokenType::FALSE, "false");
+                return Token(TokenType::FALSE, "false", start);
             }
             else if (keyword == "null")
             {
-                return Token(TokenType::NULL_TOKEN, "null");
+                return Token(TokenType::NULL_TOKEN, "null", start);
             }
             else
             {
@@ -283,5 +444,5 @@ Token Lexer::getNextToken()
         }
     }
 
-    return Token(TokenType::EOF_TOKEN, "");
+    return Token(TokenType::EOF_TOKEN, "", pos);
 }
\ No newline at end of file
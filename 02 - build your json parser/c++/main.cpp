@@ -1,48 +1,195 @@
+#include "formatter.hpp"
 #include "json_parser.hpp"
+#include "mapped_file.hpp"
+#include "output_buffer.hpp"
+#include "profile.hpp"
+#include "query.hpp"
+#include "snapshot.hpp"
+#include <cstdio>
 #include <fstream>
 #include <iostream>
-#include <sstream>
 #include <string>
 
 void print_usage(const char *program_name)
 {
-    std::cout << "Usage: " << program_name << " <input_file>\n";
+    std::cout << "Usage: " << program_name << " [options] <input_file>\n"
+              << "\n"
+              << "  <input_file>            .json file to parse, or .jsnap snapshot to print\n"
+              << "\n"
+              << "Options (at most one mode):\n"
+              << "  --snapshot <file>       write the parsed document as a binary snapshot\n"
+              << "  --profile               print time and allocations per phase to stderr\n"
+              << "  --stream                reformat token by token without building a tree\n"
+              << "  --minify                stream without whitespace (implies --stream)\n"
+              << "  --sort-keys             stream with object members in key order (implies --stream)\n"
+              << "  --query <paths>         print only the given paths, e.g. .user.id,.tags[0], of\n"
+              << "                          each record; .ndjson/.jsonl files have one record per line\n"
+              << "  --format tsv|json       output of --query (default tsv)\n";
 }
 
-bool readWholeFile(std::string path, std::string &out)
+// Pretty prints value to stdout through a large buffer, so the output is
+// never held in memory as a whole
+void printJson(const JsonValue &value)
 {
-    std::ifstream in(path, std::ios::binary);
-    if (!in)
+    OutputBuffer out(stdout);
+    value.write(out);
+    out.put('\n');
+    out.flush();
+}
+
+bool hasExtension(const std::string &path, const std::string &extension)
+{
+    if (path.size() < extension.size() ||
+        path.compare(path.size() - extension.size(), extension.size(), extension) != 0)
     {
         return false;
     }
-    // ostringstream to read the whole file content
-    std::ostringstream ss;
-    // Read file content into the stringstream
-    ss << in.rdbuf();
-    // Assign the content to the output string
-    out = ss.str();
     return true;
 }
 
 bool hasJsonExtension(const std::string &path)
 {
-    if (path.size() < 5 || path.substr(path.size() - 5) != ".json")
-    {
-        return false;
-    }
-    return true;
+    return hasExtension(path, ".json");
 }
 
 int main(int argc, char **argv)
 {
-    if (argc < 2)
+    std::string input_path;
+    std::string snapshot_path;
+    bool profile = false;
+    bool stream = false;
+    FormatOptions format;
+    std::string query;
+    bool has_query = false; // --query '' is an error, not "no query"
+    QueryFormat query_format = QueryFormat::TSV;
+
+    for (int i = 1; i < argc; i++)
+    {
+        std::string arg = argv[i];
+        if (arg == "--snapshot" && i + 1 < argc)
+        {
+            snapshot_path = argv[++i];
+        }
+        else if (arg == "--profile")
+        {
+            profile = true;
+        }
+        else if (arg == "--query" && i + 1 < argc)
+        {
+            query = argv[++i];
+            has_query = true;
+        }
+        else if (arg == "--format" && i + 1 < argc)
+        {
+            std::string name = argv[++i];
+            if (name != "tsv" && name != "json")
+            {
+                print_usage(argv[0]);
+                return 2; // usage error / internal error
+            }
+            query_format = name == "json" ? QueryFormat::JSON : QueryFormat::TSV;
+        }
+        else if (arg == "--stream")
+        {
+            stream = true;
+        }
+        else if (arg == "--minify")
+        {
+            stream = true;
+            format.minify = true;
+        }
+        else if (arg == "--sort-keys")
+        {
+            stream = true;
+            format.sortKeys = true;
+        }
+        else if (input_path.empty() && arg.compare(0, 2, "--") != 0)
+        {
+            input_path = arg;
+        }
+        else
+        {
+            print_usage(argv[0]);
+            return 2; // usage error / internal error
+        }
+    }
+
+    int modes = !snapshot_path.empty() + profile + stream + has_query;
+    if (input_path.empty() || modes > 1)
     {
         print_usage(argv[0]);
         return 2; // usage error / internal error
     }
 
-    std::string input_path = argv[1];
+    // Snapshots are read in place and printed as JSON
+    if (hasExtension(input_path, ".jsnap") && snapshot_path.empty())
+    {
+        try
+        {
+            Snapshot snapshot;
+            if (!snapshot.open(input_path))
+            {
+                std::cerr << "Error: Could not read file " << input_path << "\n";
+                return 2; // file read error
+            }
+            printJson(*snapshot.root().toJson());
+            return 0; // success
+        }
+        catch (const std::exception &e)
+        {
+            std::cout << "Invalid snapshot: " << e.what() << std::endl;
+            return 1; // parse error
+        }
+    }
+
+    // Records are checked, then scanned for the requested paths only; no
+    // tree is built for them
+    if (has_query)
+    {
+        bool lines = hasExtension(input_path, ".ndjson") || hasExtension(input_path, ".jsonl");
+        if (!lines && !hasJsonExtension(input_path))
+        {
+            std::cerr << "Error: Input file must have a .json, .ndjson or .jsonl extension\n";
+            return 2; // usage error / internal error
+        }
+
+        MappedFile input;
+        if (!input.open(input_path))
+        {
+            std::cerr << "Error: Could not read file " << input_path << "\n";
+            return 2; // file read error
+        }
+
+        try
+        {
+            Query projection(query);
+            OutputBuffer out(stdout);
+            if (lines)
+            {
+                // Bad records are reported once every line was written
+                auto errors = projection.writeLines(input.data(), input.size(), query_format, out);
+                out.flush();
+                for (const Query::LineError &error : errors)
+                {
+                    std::cerr << "Invalid JSON on line " << error.line << ": " << error.message << "\n";
+                }
+                return errors.empty() ? 0 : 1; // success / parse error
+            }
+            projection.write(input.data(), input.size(), query_format, out);
+            out.flush();
+            return 0; // success
+        }
+        catch (const ParseError &e)
+        {
+            std::cout << "Invalid JSON: " << e.what() << std::endl;
+            return 1; // parse error
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 2; // usage error / internal error
+        }
+    }
 
     // Check if the input file has a .json extension
     if (!hasJsonExtension(input_path))
@@ -51,23 +198,92 @@ int main(int argc, char **argv)
         return 2; // usage error / internal error
     }
 
-    std::string input;
+    // Runs each phase on its own so the time and allocations of each can be
+    // reported; the document is still printed as usual
+    if (profile)
+    {
+        try
+        {
+            ParseProfile report;
+            std::string output;
+            profileFile(input_path, report, &output);
+            output += '\n';
+            std::fwrite(output.data(), 1, output.size(), stdout);
+            std::fflush(stdout);
+            report.print(std::cerr);
+            return 0; // success
+        }
+        catch (const ParseError &e)
+        {
+            std::cout << "Invalid JSON: " << e.what() << std::endl;
+            return 1; // parse error
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Error: " << e.what() << "\n";
+            return 2; // file read error
+        }
+    }
+
+    // The Lexer reads straight from the mapping, so the file is never copied
+    MappedFile input;
 
-    if (!readWholeFile(input_path, input))
+    if (!input.open(input_path))
     {
         std::cerr << "Error: Could not read file " << input_path << "\n";
         return 2; // file read error
     }
 
+    // Writes the reformatted document as it is read, so memory use stays
+    // flat however large the input is
+    if (stream)
+    {
+        try
+        {
+            Lexer lexer(input.data(), input.size());
+            OutputBuffer out(stdout);
+            Formatter formatter(lexer, out, format);
+            formatter.format();
+            out.put('\n');
+            out.flush();
+            return 0; // success
+        }
+        catch (const std::exception &e)
+        {
+            std::cout << "\nInvalid JSON: " << e.what() << std::endl;
+            return 1; // parse error
+        }
+    }
+
     try
     {
         // Parse the JSON
-        Lexer lexer(input);
+        Lexer lexer(input.data(), input.size());
         Parser parser(lexer);
         JsonPtr result = parser.parse();
 
+        if (!snapshot_path.empty())
+        {
+            std::ofstream out(snapshot_path, std::ios::binary);
+            if (!out)
+            {
+                std::cerr << "Error: Could not write file " << snapshot_path << "\n";
+                return 2; // file write error
+            }
+            try
+            {
+                writeSnapshot(*result, out);
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Error: Could not write snapshot " << snapshot_path << ": " << e.what() << "\n";
+                return 2; // file write error
+            }
+            return 0; // success
+        }
+
         // Pretty print the result
-        std::cout << result->toString() << std::endl;
+        printJson(*result);
 
         return 0; // success
     }
@@ -0,0 +1,107 @@
+#include "mapped_file.hpp"
+
+#ifdef _WIN32
+#include <fstream>
+#include <sstream>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#ifndef _WIN32
+// Reads fd to the end into buffer
+bool MappedFile::readAll(int fd)
+{
+    char chunk[65536];
+    while (true)
+    {
+        ssize_t count = ::read(fd, chunk, sizeof(chunk));
+        if (count == 0)
+        {
+            break;
+        }
+        if (count < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            buffer.clear();
+            return false;
+        }
+        buffer.append(chunk, static_cast<size_t>(count));
+    }
+    bytes = buffer.data();
+    length = buffer.size();
+    return true;
+}
+#endif
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+bool MappedFile::open(const std::string &path)
+{
+    close();
+
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    // Pipes, terminals and the like cannot be mapped, and files that report
+    // no size (empty ones, or /proc entries) may still have contents; all of
+    // them are read instead
+    struct stat info;
+    if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode) && info.st_size > 0)
+    {
+        length = static_cast<size_t>(info.st_size);
+        void *addr = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (addr != MAP_FAILED)
+        {
+            ::close(fd); // the mapping keeps its own reference to the file
+            bytes = static_cast<const char *>(addr);
+            mapped = true;
+            return true;
+        }
+        length = 0;
+    }
+
+    bool ok = readAll(fd);
+    ::close(fd);
+    return ok;
+#else
+    std::ifstream in(path, std::ios::binary);
+    if (!in)
+    {
+        return false;
+    }
+    std::ostringstream ss;
+    ss << in.rdbuf();
+    buffer = ss.str();
+    bytes = buffer.data();
+    length = buffer.size();
+    return true;
+#endif
+}
+
+void MappedFile::close()
+{
+#ifndef _WIN32
+    if (mapped)
+    {
+        munmap(const_cast<char *>(bytes), length);
+    }
+#endif
+    bytes = nullptr;
+    length = 0;
+    mapped = false;
+    buffer.clear();
+}
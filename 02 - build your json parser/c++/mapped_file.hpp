@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Read-only view of a whole file. On POSIX systems a regular file is mapped
+// with mmap, so pages are loaded on first touch and shared between processes
+// that map the same file. Anything that cannot be mapped, such as a pipe, and
+// every file on other systems, is read into memory instead.
+class MappedFile
+{
+private:
+    const char *bytes = nullptr;
+    size_t length = 0;
+    bool mapped = false;
+    std::string buffer; // file contents when mmap is not available
+
+#ifndef _WIN32
+    bool readAll(int fd);
+#endif
+
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile &) = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    // Returns false if the file cannot be opened or read
+    bool open(const std::string &path);
+    void close();
+
+    const char *data() const { return bytes; }
+    size_t size() const { return length; }
+};
@@ -0,0 +1,36 @@
+#include "output_buffer.hpp"
+#include <stdexcept>
+
+OutputBuffer::OutputBuffer(std::FILE *file, size_t capacity) : file(file), capacity(capacity)
+{
+    if (file != nullptr)
+    {
+        buffer.reserve(capacity);
+    }
+}
+
+OutputBuffer::~OutputBuffer()
+{
+    // Errors can only be reported by an explicit flush()
+    if (file != nullptr && !buffer.empty())
+    {
+        std::fwrite(buffer.data(), 1, buffer.size(), file);
+    }
+}
+
+void OutputBuffer::flush()
+{
+    if (file == nullptr)
+    {
+        return;
+    }
+    if (!buffer.empty() && std::fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size())
+    {
+        throw std::runtime_error("Failed to write output");
+    }
+    buffer.clear();
+    if (std::fflush(file) != 0)
+    {
+        throw std::runtime_error("Failed to write output");
+    }
+}
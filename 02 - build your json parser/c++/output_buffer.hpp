@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdio>
+#include <string>
+
+// Buffered writer for serialized output. With a FILE* it collects output in a
+// fixed-size block and writes the block whenever it fills up, so memory use
+// does not grow with the size of the document; without one it simply
+// accumulates everything in memory.
+class OutputBuffer
+{
+private:
+    std::FILE *file;
+    size_t capacity;
+    std::string buffer;
+
+public:
+    static const size_t DEFAULT_CAPACITY = 1 << 20;
+
+    explicit OutputBuffer(std::FILE *file = nullptr, size_t capacity = DEFAULT_CAPACITY);
+    ~OutputBuffer();
+
+    OutputBuffer(const OutputBuffer &) = delete;
+    OutputBuffer &operator=(const OutputBuffer &) = delete;
+
+    void write(const char *data, size_t length)
+    {
+        if (file != nullptr && buffer.size() + length > capacity)
+        {
+            flush();
+        }
+        buffer.append(data, length);
+    }
+    void write(const std::string &text) { write(text.data(), text.size()); }
+    void put(char c)
+    {
+        if (file != nullptr && buffer.size() >= capacity)
+        {
+            flush();
+        }
+        buffer += c;
+    }
+    // Writes count copies of c, e.g. for indentation
+    void fill(char c, size_t count)
+    {
+        if (file != nullptr && buffer.size() + count > capacity)
+        {
+            flush();
+        }
+        buffer.append(count, c);
+    }
+
+    // Writes buffered output to the file; throws std::runtime_error on failure
+    void flush();
+
+    // Everything written so far, when there is no file
+    std::string &str() { return buffer; }
+};
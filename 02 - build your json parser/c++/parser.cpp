@@ -1,13 +1,28 @@
 #include "json_parser.hpp"
+#include "output_buffer.hpp"
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <stdexcept>
 #include <sstream>
 #include <string>
+#include <functional>
 
 // Parser implementation
-Parser::Parser(Lexer &lex) : lexer(lex), currentToken(TokenType::INVALID)
+Parser::Parser(Lexer &lex, size_t maxDepth)
+    : lexer(lex), currentToken(TokenType::INVALID), maxDepth(maxDepth)
 {
     currentToken = lexer.getNextToken(); // Prime the parser
+    tokensRead++;
+}
+
+// Reports msg at the current token
+void Parser::error(const std::string &msg) const
+{
+    lexer.errorAt("Parser", currentToken.offset, msg);
 }
 
 void Parser::checkToken(TokenType expected)
@@ -17,141 +32,235 @@ void Parser::checkToken(TokenType expected)
         std::ostringstream oss;
         oss << "Expected token type " << static_cast<int>(expected)
             << " but got " << static_cast<int>(currentToken.type);
-        throw std::runtime_error(oss.str());
+        error(oss.str());
     }
     currentToken = lexer.getNextToken();
+    tokensRead++;
 }
 
 JsonPtr Parser::parse()
 {
+    buildTree = true;
     JsonPtr result = parseValue();
 
     // Check for trailing content
     if (currentToken.type != TokenType::EOF_TOKEN)
     {
-        throw std::runtime_error("Extra content after JSON value");
+        error("Extra content after JSON value");
     }
 
     return result;
 }
 
-JsonPtr Parser::parseValue()
+void Parser::validate()
 {
-    switch (currentToken.type)
-    {
-    case TokenType::LBRACE:
-        return parseObject();
-    case TokenType::LBRACKET:
-        return parseArray();
-    case TokenType::STRING:
-        return parseString();
-    case TokenType::NUMBER:
-        return parseNumber();
-    case TokenType::TRUE:
-    case TokenType::FALSE:
-        return parseBoolean();
-    case TokenType::NULL_TOKEN:
-        return parseNull();
-    default:
-        throw std::runtime_error("Unexpected token in value");
+    buildTree = false;
+    parseValue();
+
+    // Check for trailing content
+    if (currentToken.type != TokenType::EOF_TOKEN)
+    {
+        error("Extra content after JSON value");
     }
 }
 
-JsonPtr Parser::parseObject()
+// Parses one complete value. Instead of recursing into nested containers,
+// each open object/array is pushed onto `stack` and finished values are
+// attached to the container on top of it. When buildTree is false the
+// grammar is checked but no nodes are allocated and nullptr is returned.
+JsonPtr Parser::parseValue()
 {
-    auto obj = std::make_shared<JsonObject>();
-    checkToken(TokenType::LBRACE); // consume {
-
-    // Handle empty object
-    if (currentToken.type == TokenType::RBRACE)
-    {
-        checkToken(TokenType::RBRACE);
-        return obj;
-    }
+    stack.clear();
 
     while (true)
     {
-        // Expect string key
-        if (currentToken.type != TokenType::STRING)
-        {
-            throw std::runtime_error("Expected string key in object");
-        }
-        std::string key = currentToken.value;
-        checkToken(TokenType::STRING);
-
-        // Expect colon
-        checkToken(TokenType::COLON);
+        JsonPtr value;
+        size_t start = currentToken.offset; // of the value attached below, for spans
 
-        // Parse value
-        JsonPtr value = parseValue();
-        obj->properties.push_back({key, value});
-
-        // Check for continuation
-        if (currentToken.type == TokenType::COMMA)
+        switch (currentToken.type)
         {
-            checkToken(TokenType::COMMA);
+        case TokenType::LBRACE:
+            checkToken(TokenType::LBRACE); // consume {
 
-            // Check for trailing comma
+            // Handle empty object
             if (currentToken.type == TokenType::RBRACE)
             {
-                throw std::runtime_error("Trailing comma in object");
+                size_t end = currentToken.offset + 1;
+                checkToken(TokenType::RBRACE);
+                if (buildTree)
+                {
+                    value = std::make_shared<JsonObject>();
+                    recordSpan(value, start, end, {});
+                }
+                break;
             }
-        }
-        else if (currentToken.type == TokenType::RBRACE)
-        {
+            pushContainer(buildTree ? std::make_shared<JsonObject>() : nullptr, true, start);
+            parseKey();
+            continue;
+        case TokenType::LBRACKET:
+            checkToken(TokenType::LBRACKET); // consume [
+
+            // Handle empty array
+            if (currentToken.type == TokenType::RBRACKET)
+            {
+                size_t end = currentToken.offset + 1;
+                checkToken(TokenType::RBRACKET);
+                if (buildTree)
+                {
+                    value = std::make_shared<JsonArray>();
+                    recordSpan(value, start, end, {});
+                }
+                break;
+            }
+            pushContainer(buildTree ? std::make_shared<JsonArray>() : nullptr, false, start);
+            continue;
+        case TokenType::STRING:
+            value = buildTree ? parseString() : skipScalar();
+            break;
+        case TokenType::NUMBER:
+            value = buildTree ? parseNumber() : skipScalar();
             break;
+        case TokenType::TRUE:
+        case TokenType::FALSE:
+            value = buildTree ? parseBoolean() : skipScalar();
+            break;
+        case TokenType::NULL_TOKEN:
+            value = buildTree ? parseNull() : skipScalar();
+            break;
+        default:
+            error("Unexpected token in value");
         }
-        else
+
+        // Attach the finished value to its parent. A closing bracket finishes
+        // the parent as well, so keep unwinding until a comma asks for the
+        // next value or the outermost value is complete.
+        while (true)
         {
-            throw std::runtime_error("Expected comma or } in object");
+            valuesRead++;
+            if (stack.empty())
+            {
+                return value;
+            }
+
+            Frame &top = stack.back();
+            bool isObject = top.isObject;
+            if (spans != nullptr && buildTree)
+            {
+                top.childOffsets.push_back(start - top.start);
+            }
+            if (!buildTree)
+            {
+                // Nothing to attach when only validating
+            }
+            else if (isObject)
+            {
+                auto obj = static_cast<JsonObject *>(top.container.get());
+                obj->properties.push_back({std::move(top.key), std::move(value)});
+            }
+            else
+            {
+                auto arr = static_cast<JsonArray *>(top.container.get());
+                arr->elements.push_back(std::move(value));
+            }
+
+            TokenType closing = isObject ? TokenType::RBRACE : TokenType::RBRACKET;
+
+            // Check for continuation
+            if (currentToken.type == TokenType::COMMA)
+            {
+                checkToken(TokenType::COMMA);
+
+                // Check for trailing comma
+                if (currentToken.type == closing)
+                {
+                    error(isObject ? "Trailing comma in object" : "Trailing comma in array");
+                }
+                if (isObject)
+                {
+                    parseKey();
+                }
+                break;
+            }
+            if (currentToken.type != closing)
+            {
+                error(isObject ? "Expected comma or } in object" : "Expected comma or ] in array");
+            }
+
+            size_t closeEnd = currentToken.offset + 1;
+            checkToken(closing);
+            value = std::move(top.container);
+            start = top.start;
+            recordSpan(value, start, closeEnd, std::move(top.childOffsets));
+            stack.pop_back();
         }
     }
-
-    checkToken(TokenType::RBRACE);
-    return obj;
 }
 
-JsonPtr Parser::parseArray()
+void Parser::recordSpan(const JsonPtr &container, size_t start, size_t end, std::vector<size_t> childOffsets)
 {
-    auto arr = std::make_shared<JsonArray>();
-    checkToken(TokenType::LBRACKET); // consume [
+    if (spans != nullptr && container)
+    {
+        (*spans)[container.get()] = {end - start, std::move(childOffsets)};
+    }
+}
 
-    // Handle empty array
-    if (currentToken.type == TokenType::RBRACKET)
+void Parser::pushContainer(JsonPtr container, bool isObject, size_t start)
+{
+    if (stack.size() >= maxDepth)
     {
-        checkToken(TokenType::RBRACKET);
-        return arr;
+        std::ostringstream oss;
+        oss << "Maximum nesting depth of " << maxDepth << " exceeded";
+        error(oss.str());
     }
+    stack.push_back({std::move(container), JsonKey(), isObject, start, {}});
+}
 
-    while (true)
+// Reads `"key" :` into the pending key of the object on top of the stack
+void Parser::parseKey()
+{
+    // Expect string key
+    if (currentToken.type != TokenType::STRING)
+    {
+        error("Expected string key in object");
+    }
+    if (!buildTree)
+    {
+        // Key is not stored when only validating
+    }
+    else if (keyTable != nullptr)
+    {
+        stack.back().key = JsonKey(keyTable->intern(currentToken.value));
+    }
+    else
     {
-        // Parse value
-        JsonPtr value = parseValue();
-        arr->elements.push_back(value);
+        stack.back().key = JsonKey(currentToken.value);
+    }
+    checkToken(TokenType::STRING);
 
-        // Check for continuation
-        if (currentToken.type == TokenType::COMMA)
-        {
-            checkToken(TokenType::COMMA);
+    // Expect colon
+    checkToken(TokenType::COLON);
+}
 
-            // Check for trailing comma
-            if (currentToken.type == TokenType::RBRACKET)
-            {
-                throw std::runtime_error("Trailing comma in array");
-            }
-        }
-        else if (currentToken.type == TokenType::RBRACKET)
-        {
-            break;
-        }
-        else
-        {
-            throw std::runtime_error("Expected comma or ] in array");
-        }
+JsonPtr Parser::skipScalar()
+{
+    // Numbers are range-checked even when only validating, so that parse()
+    // and validate() accept the same documents
+    if (currentToken.type == TokenType::NUMBER)
+    {
+        numberValue();
     }
+    checkToken(currentToken.type);
+    return nullptr;
+}
 
-    checkToken(TokenType::RBRACKET);
-    return arr;
+double Parser::numberValue() const
+{
+    double value;
+    if (!parseJsonNumber(currentToken.value, value))
+    {
+        error("Number out of range: " + currentToken.value);
+    }
+    return value;
 }
 
 JsonPtr Parser::parseString()
@@ -163,8 +272,7 @@ JsonPtr Parser::parseString()
 
 JsonPtr Parser::parseNumber()
 {
-    double value = std::stod(currentToken.value);
-    auto num = std::make_shared<JsonNumber>(value);
+    auto num = std::make_shared<JsonNumber>(numberValue());
     checkToken(TokenType::NUMBER);
     return num;
 }
@@ -184,61 +292,436 @@ JsonPtr Parser::parseNull()
     return null;
 }
 
-// JSON Value toString implementations
-std::string JsonObject::toString(int indent) const
+// InternTable implementation
+const std::string *InternTable::intern(const std::string &text)
+{
+    Shard &shard = shards[std::hash<std::string>()(text) % SHARD_COUNT];
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    // Set nodes never move, so the address stays valid for the table's lifetime
+    return &*shard.strings.insert(text).first;
+}
+
+size_t InternTable::size()
 {
-    if (properties.empty())
+    size_t total = 0;
+    for (Shard &shard : shards)
     {
-        return "{}";
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        total += shard.strings.size();
     }
+    return total;
+}
 
-    std::string result = "{\n";
-    std::string indentStr(indent + 2, ' ');
+bool parseJsonNumber(const std::string &text, double &value)
+{
+    // strtod sets ERANGE on underflow as well, where the result is still the
+    // closest double; only an overflow to HUGE_VAL is an error
+    errno = 0;
+    value = std::strtod(text.c_str(), nullptr);
+    return !(errno == ERANGE && (value == HUGE_VAL || value == -HUGE_VAL));
+}
 
-    for (size_t i = 0; i < properties.size(); i++)
+// JsonKey implementation
+void JsonKey::assign(const char *text, size_t size)
+{
+    length = size;
+    if (size <= INLINE_SIZE)
+    {
+        kind = INLINE;
+        std::memcpy(small, text, size);
+    }
+    else
     {
-        result += indentStr + "\"" + properties[i].first + "\": ";
-        result += properties[i].second->toString(indent + 2);
+        kind = HEAP;
+        heap = new char[size];
+        std::memcpy(heap, text, size);
+    }
+}
 
-        if (i < properties.size() - 1)
+void JsonKey::release()
+{
+    if (kind == HEAP)
+    {
+        delete[] heap;
+    }
+    kind = INLINE;
+    length = 0;
+}
+
+JsonKey::JsonKey(const JsonKey &other)
+{
+    if (other.kind == INTERNED)
+    {
+        interned = other.interned;
+        length = other.length;
+        kind = INTERNED;
+    }
+    else
+    {
+        assign(other.data(), other.length);
+    }
+}
+
+JsonKey::JsonKey(JsonKey &&other) noexcept
+{
+    *this = std::move(other);
+}
+
+JsonKey &JsonKey::operator=(const JsonKey &other)
+{
+    if (this != &other)
+    {
+        JsonKey copy(other);
+        *this = std::move(copy);
+    }
+    return *this;
+}
+
+// Takes over other's storage; other is left as an empty key
+JsonKey &JsonKey::operator=(JsonKey &&other) noexcept
+{
+    if (this != &other)
+    {
+        release();
+        if (other.kind == INLINE)
         {
-            result += ",";
+            std::memcpy(small, other.small, other.length);
         }
-        result += "\n";
+        else if (other.kind == HEAP)
+        {
+            heap = other.heap;
+        }
+        else
+        {
+            interned = other.interned;
+        }
+        length = other.length;
+        kind = other.kind;
+        other.kind = INLINE;
+        other.length = 0;
     }
+    return *this;
+}
 
-    result += std::string(indent, ' ') + "}";
-    return result;
+// Releases a tree without recursing once per level: children that are
+// solely owned containers are moved onto a local worklist, so every
+// destructor only ever sees containers whose children were already taken.
+static void collectChild(std::vector<JsonPtr> &pending, JsonPtr &child)
+{
+    if (child && child.use_count() == 1 &&
+        (child->type == JsonType::OBJECT || child->type == JsonType::ARRAY))
+    {
+        pending.push_back(std::move(child));
+    }
 }
 
-std::string JsonArray::toString(int indent) const
+static void releaseChildren(std::vector<JsonPtr> &pending)
 {
-    if (elements.empty())
+    while (!pending.empty())
     {
-        return "[]";
+        JsonPtr node = std::move(pending.back());
+        pending.pop_back();
+
+        if (node->type == JsonType::OBJECT)
+        {
+            for (auto &prop : static_cast<JsonObject *>(node.get())->properties)
+            {
+                collectChild(pending, prop.second);
+            }
+        }
+        else
+        {
+            for (auto &elem : static_cast<JsonArray *>(node.get())->elements)
+            {
+                collectChild(pending, elem);
+            }
+        }
+    }
+}
+
+JsonObject::~JsonObject()
+{
+    std::vector<JsonPtr> pending;
+    for (auto &prop : properties)
+    {
+        collectChild(pending, prop.second);
     }
+    releaseChildren(pending);
+}
 
-    std::string result = "[\n";
-    std::string indentStr(indent + 2, ' ');
+JsonArray::~JsonArray()
+{
+    std::vector<JsonPtr> pending;
+    for (auto &elem : elements)
+    {
+        collectChild(pending, elem);
+    }
+    releaseChildren(pending);
+}
 
-    for (size_t i = 0; i < elements.size(); i++)
+// FNV-1a; the index hashes member keys and lookup strings alike
+static size_t hashKey(const char *data, size_t size)
+{
+    size_t h = 14695981039346656037ull;
+    for (size_t i = 0; i < size; i++)
     {
-        result += indentStr + elements[i]->toString(indent + 2);
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 1099511628211ull;
+    }
+    return h;
+}
 
-        if (i < elements.size() - 1)
+JsonPtr JsonObject::find(const std::string &key) const
+{
+    // Small objects are cheaper to scan than to hash
+    if (properties.size() < INDEX_THRESHOLD)
+    {
+        for (size_t i = properties.size(); i-- > 0;)
         {
-            result += ",";
+            if (properties[i].first == key)
+            {
+                return properties[i].second;
+            }
         }
-        result += "\n";
+        return nullptr;
     }
 
-    result += std::string(indent, ' ') + "]";
-    return result;
+    buildIndex();
+
+    size_t mask = index.size() - 1;
+    for (size_t slot = hashKey(key.data(), key.size()) & mask; index[slot] != 0; slot = (slot + 1) & mask)
+    {
+        const auto &prop = properties[index[slot] - 1];
+        if (prop.first == key)
+        {
+            return prop.second;
+        }
+    }
+    return nullptr;
+}
+
+void JsonObject::buildIndex() const
+{
+    if (indexedCount == properties.size() && !index.empty())
+    {
+        return;
+    }
+
+    // Keep the table at most half full; rebuild from scratch when it grows or
+    // when members were removed since the last build
+    if (properties.size() < indexedCount || properties.size() * 2 > index.size())
+    {
+        size_t capacity = 16;
+        while (capacity < properties.size() * 2)
+        {
+            capacity *= 2;
+        }
+        index.assign(capacity, 0);
+        indexedCount = 0;
+    }
+
+    for (; indexedCount < properties.size(); indexedCount++)
+    {
+        indexMember(indexedCount);
+    }
+}
+
+void JsonObject::invalidateIndex() const
+{
+    index.clear();
+    indexedCount = 0;
+}
+
+void JsonObject::indexMember(size_t pos) const
+{
+    const JsonKey &key = properties[pos].first;
+    size_t mask = index.size() - 1;
+    size_t slot = hashKey(key.data(), key.size()) & mask;
+
+    // A duplicate key takes over the slot of the earlier member
+    while (index[slot] != 0 && properties[index[slot] - 1].first != key)
+    {
+        slot = (slot + 1) & mask;
+    }
+    index[slot] = pos + 1;
+}
+
+// Pretty printer. Open containers are kept on an explicit stack so deeply
+// nested documents cannot overflow the call stack, and scalars are written
+// straight into the buffer instead of going through toString.
+struct SerializeFrame
+{
+    const JsonValue *container;
+    size_t next; // index of the next child to write
+    int indent;
+};
+
+static size_t childCount(const JsonValue &container)
+{
+    if (container.type == JsonType::OBJECT)
+    {
+        return static_cast<const JsonObject &>(container).properties.size();
+    }
+    return static_cast<const JsonArray &>(container).elements.size();
+}
+
+void writeJsonString(OutputBuffer &out, const char *data, size_t size)
+{
+    out.put('"');
+
+    // Write runs that need no escaping in one piece
+    size_t runStart = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        unsigned char c = static_cast<unsigned char>(data[i]);
+        if (c != '"' && c != '\\' && c >= 0x20)
+        {
+            continue;
+        }
+
+        out.write(data + runStart, i - runStart);
+        runStart = i + 1;
+        switch (c)
+        {
+        case '"':
+            out.write("\\\"", 2);
+            break;
+        case '\\':
+            out.write("\\\\", 2);
+            break;
+        case '\b':
+            out.write("\\b", 2);
+            break;
+        case '\f':
+            out.write("\\f", 2);
+            break;
+        case '\n':
+            out.write("\\n", 2);
+            break;
+        case '\r':
+            out.write("\\r", 2);
+            break;
+        case '\t':
+            out.write("\\t", 2);
+            break;
+        default:
+        {
+            char escape[8];
+            std::snprintf(escape, sizeof(escape), "\\u%04x", c);
+            out.write(escape, 6);
+        }
+        }
+    }
+    out.write(data + runStart, size - runStart);
+    out.put('"');
+}
+
+static void writeScalar(const JsonValue &value, OutputBuffer &out)
+{
+    switch (value.type)
+    {
+    case JsonType::STRING:
+        writeJsonString(out, static_cast<const JsonString &>(value).value);
+        break;
+    case JsonType::NUMBER:
+    {
+        // %g matches the default formatting of operator<< used by toString
+        char buffer[32];
+        int length = std::snprintf(buffer, sizeof(buffer), "%g", static_cast<const JsonNumber &>(value).value);
+        out.write(buffer, static_cast<size_t>(length));
+        break;
+    }
+    case JsonType::BOOLEAN:
+        out.write(static_cast<const JsonBoolean &>(value).value ? "true" : "false");
+        break;
+    default:
+        out.write("null", 4);
+        break;
+    }
+}
+
+void JsonValue::write(OutputBuffer &out, int indent) const
+{
+    std::vector<SerializeFrame> stack;
+    const JsonValue *value = this;
+
+    while (value != nullptr)
+    {
+        bool isContainer = value->type == JsonType::OBJECT || value->type == JsonType::ARRAY;
+        if (!isContainer)
+        {
+            writeScalar(*value, out);
+        }
+        else if (childCount(*value) == 0)
+        {
+            out.write(value->type == JsonType::OBJECT ? "{}" : "[]", 2);
+        }
+        else
+        {
+            out.write(value->type == JsonType::OBJECT ? "{\n" : "[\n", 2);
+            stack.push_back({value, 0, indent});
+        }
+
+        // Find the next child to write, closing containers that are done
+        value = nullptr;
+        while (!stack.empty())
+        {
+            SerializeFrame &top = stack.back();
+            bool isObject = top.container->type == JsonType::OBJECT;
+
+            if (top.next == childCount(*top.container))
+            {
+                out.put('\n');
+                out.fill(' ', top.indent);
+                out.put(isObject ? '}' : ']');
+                stack.pop_back();
+                continue;
+            }
+
+            if (top.next > 0)
+            {
+                out.write(",\n", 2);
+            }
+            out.fill(' ', top.indent + 2);
+
+            if (isObject)
+            {
+                const auto &prop = static_cast<const JsonObject *>(top.container)->properties[top.next];
+                writeJsonString(out, prop.first.data(), prop.first.size());
+                out.write(": ", 2);
+                value = prop.second.get();
+            }
+            else
+            {
+                value = static_cast<const JsonArray *>(top.container)->elements[top.next].get();
+            }
+            indent = top.indent + 2;
+            top.next++;
+            break;
+        }
+    }
+}
+
+// JSON Value toString implementations
+std::string JsonObject::toString(int indent) const
+{
+    OutputBuffer out;
+    write(out, indent);
+    return std::move(out.str());
+}
+
+std::string JsonArray::toString(int indent) const
+{
+    OutputBuffer out;
+    write(out, indent);
+    return std::move(out.str());
 }
 
 std::string JsonString::toString(int indent) const
 {
-    return "\"" + value + "\"";
+    OutputBuffer out;
+    writeJsonString(out, value);
+    return std::move(out.str());
 }
 
 std::string JsonNumber::toString(int indent) const
@@ -0,0 +1,174 @@
+#include "profile.hpp"
+#include "json_parser.hpp"
+#include "mapped_file.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <stdexcept>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+// Allocation counters, fed by the operator new in allocation_hooks.cpp
+static std::atomic<bool> countingEnabled(false);
+static std::atomic<size_t> allocations(0);
+static std::atomic<size_t> bytesAllocated(0);
+
+void recordAllocation(size_t size)
+{
+    if (countingEnabled.load(std::memory_order_relaxed))
+    {
+        allocations.fetch_add(1, std::memory_order_relaxed);
+        bytesAllocated.fetch_add(size, std::memory_order_relaxed);
+    }
+}
+
+void enableAllocationCounting(bool enabled)
+{
+    countingEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+size_t allocationCount()
+{
+    return allocations.load(std::memory_order_relaxed);
+}
+
+size_t allocatedBytes()
+{
+    return bytesAllocated.load(std::memory_order_relaxed);
+}
+
+size_t peakMemory()
+{
+#ifdef _WIN32
+    return 0;
+#else
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0)
+    {
+        return 0;
+    }
+#ifdef __APPLE__
+    return static_cast<size_t>(usage.ru_maxrss); // already in bytes
+#else
+    return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+// Measures one phase from construction until stop()
+class PhaseTimer
+{
+private:
+    PhaseProfile &phase;
+    std::chrono::steady_clock::time_point start;
+    size_t allocationsBefore;
+    size_t bytesBefore;
+
+public:
+    explicit PhaseTimer(PhaseProfile &p)
+        : phase(p), start(std::chrono::steady_clock::now()), allocationsBefore(allocationCount()),
+          bytesBefore(allocatedBytes())
+    {
+    }
+
+    void stop()
+    {
+        phase.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        phase.allocations = allocationCount() - allocationsBefore;
+        phase.bytes = allocatedBytes() - bytesBefore;
+    }
+};
+
+void profileFile(const std::string &path, ParseProfile &profile, std::string *output)
+{
+    bool wasCounting = countingEnabled.load();
+    enableAllocationCounting(true);
+
+    // Touch every page so the read cost is not hidden in the lex phase
+    MappedFile input;
+    PhaseTimer read(profile.read);
+    if (!input.open(path))
+    {
+        enableAllocationCounting(wasCounting);
+        throw std::runtime_error("Could not read file " + path);
+    }
+    volatile char sink = 0;
+    for (size_t i = 0; i < input.size(); i += 4096)
+    {
+        sink = sink + input.data()[i];
+    }
+    read.stop();
+
+    enableAllocationCounting(wasCounting);
+    profileParse(input.data(), input.size(), profile, output);
+}
+
+void profileParse(const char *data, size_t size, ParseProfile &profile, std::string *output)
+{
+    bool wasCounting = countingEnabled.load();
+    enableAllocationCounting(true);
+    profile.inputBytes = size;
+
+    try
+    {
+        PhaseTimer lex(profile.lex);
+        Lexer tokens(data, size);
+        while (tokens.getNextToken().type != TokenType::EOF_TOKEN)
+        {
+        }
+        lex.stop();
+
+        // The Parser pulls its tokens from the Lexer, so this phase includes
+        // lexing; it is reported as is rather than as a difference of runs
+        PhaseTimer parse(profile.parse);
+        Lexer lexer(data, size);
+        Parser parser(lexer);
+        JsonPtr result = parser.parse();
+        parse.stop();
+        profile.tokenCount = parser.tokenCount();
+        profile.nodeCount = parser.nodeCount();
+
+        PhaseTimer toString(profile.toString);
+        std::string text = result->toString();
+        toString.stop();
+        if (output != nullptr)
+        {
+            *output = std::move(text);
+        }
+
+        PhaseTimer destroy(profile.destroy);
+        result.reset();
+        destroy.stop();
+    }
+    catch (...)
+    {
+        enableAllocationCounting(wasCounting);
+        throw;
+    }
+
+    enableAllocationCounting(wasCounting);
+    profile.peakMemory = peakMemory();
+}
+
+void ParseProfile::print(std::ostream &out) const
+{
+    char line[128];
+    std::snprintf(line, sizeof(line), "%-10s %12s %12s %14s\n", "phase", "ms", "allocations", "bytes");
+    out << line;
+
+    const std::pair<const char *, const PhaseProfile *> phases[] = {
+        {"read", &read}, {"lex", &lex}, {"lex+parse", &parse}, {"toString", &toString}, {"destroy", &destroy}};
+    for (const auto &phase : phases)
+    {
+        std::snprintf(line, sizeof(line), "%-10s %12.3f %12zu %14zu\n", phase.first, phase.second->seconds * 1000,
+                      phase.second->allocations, phase.second->bytes);
+        out << line;
+    }
+
+    out << "input bytes: " << inputBytes << "\n"
+        << "tokens: " << tokenCount << "\n"
+        << "nodes: " << nodeCount << "\n"
+        << "peak memory: " << peakMemory << " bytes\n";
+}
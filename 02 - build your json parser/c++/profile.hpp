@@ -0,0 +1,56 @@
+#pragma once
+#include <cstddef>
+#include <ostream>
+#include <string>
+
+// Opt-in instrumentation for parse runs. Allocations are only seen by
+// programs that link allocation_hooks.cpp, which replaces the global
+// operator new/delete and reports to recordAllocation; json_parser and
+// json_bench do, the library itself does not, and without the hooks the
+// counters stay at zero. Counting is off until enableAllocationCounting(true)
+// is called.
+
+void enableAllocationCounting(bool enabled);
+size_t allocationCount();
+size_t allocatedBytes();
+
+// Counts one allocation of size bytes while counting is enabled
+void recordAllocation(size_t size);
+
+// Peak resident set size of the process in bytes (0 if unknown)
+size_t peakMemory();
+
+// Time and allocations spent in one phase of a profiled run
+struct PhaseProfile
+{
+    double seconds = 0;
+    size_t allocations = 0;
+    size_t bytes = 0;
+};
+
+struct ParseProfile
+{
+    size_t inputBytes = 0;
+
+    PhaseProfile read;     // reading the file (every page of the mapping is touched)
+    PhaseProfile lex;      // a lexer-only pass over the input
+    PhaseProfile parse;    // a full parse: lexing and building the tree
+    PhaseProfile toString; // JsonValue::toString of the whole document
+    PhaseProfile destroy;  // releasing the tree
+
+    size_t tokenCount = 0;
+    size_t nodeCount = 0;
+    size_t peakMemory = 0;
+
+    // Writes a human readable report, one line per phase
+    void print(std::ostream &out) const;
+};
+
+// Reads and parses path one phase at a time, recording each phase in
+// profile. The serialized document is stored in output unless it is null.
+// Throws std::runtime_error if the file cannot be read and ParseError if it
+// is not valid JSON.
+void profileFile(const std::string &path, ParseProfile &profile, std::string *output = nullptr);
+
+// Same as profileFile for input that is already in memory (read stays empty)
+void profileParse(const char *data, size_t size, ParseProfile &profile, std::string *output = nullptr);
@@ -0,0 +1,454 @@
+#include "query.hpp"
+#include "formatter.hpp"
+#include "json_parser.hpp"
+#include "structural_scan.hpp"
+#include <cstring>
+#include <stdexcept>
+
+Query::Query(const std::string &paths)
+{
+    nodes.push_back(Node());
+
+    size_t start = 0;
+    while (start <= paths.size())
+    {
+        size_t end = paths.find(',', start);
+        if (end == std::string::npos)
+        {
+            end = paths.size();
+        }
+
+        // Allow spaces around the commas
+        size_t first = paths.find_first_not_of(' ', start);
+        size_t last = paths.find_last_not_of(' ', end - 1);
+        std::string path = first < end && last != std::string::npos && last >= first
+                               ? paths.substr(first, last - first + 1)
+                               : "";
+
+        size_t node = addPath(path);
+        nodes[node].outputs.push_back(pathList.size());
+        pathList.push_back(path);
+        start = end + 1;
+    }
+
+    // Children are always added after their parent, so a backward pass sees
+    // every child before the node it hangs from
+    for (size_t n = nodes.size(); n-- > 0;)
+    {
+        Node &node = nodes[n];
+        node.below.insert(node.below.end(), node.outputs.begin(), node.outputs.end());
+        for (const auto &entry : node.keys)
+        {
+            node.below.insert(node.below.end(), nodes[entry.second].below.begin(), nodes[entry.second].below.end());
+        }
+        for (const auto &entry : node.indices)
+        {
+            node.below.insert(node.below.end(), nodes[entry.second].below.begin(), nodes[entry.second].below.end());
+        }
+    }
+}
+
+// Adds the steps of path to the trie and returns the node where it ends
+size_t Query::addPath(const std::string &path)
+{
+    if (path == ".")
+    {
+        return 0;
+    }
+    if (path.empty())
+    {
+        throw std::runtime_error("Empty query path");
+    }
+
+    size_t node = 0;
+    size_t pos = 0;
+    while (pos < path.size())
+    {
+        if (path[pos] == '.')
+        {
+            size_t end = path.find_first_of(".[", pos + 1);
+            if (end == std::string::npos)
+            {
+                end = path.size();
+            }
+            if (end == pos + 1 && end < path.size() && path[end] == '[')
+            {
+                pos = end; // ".[0]" is the same as "[0]"
+                continue;
+            }
+            if (end == pos + 1)
+            {
+                throw std::runtime_error("Missing key in query path: " + path);
+            }
+            node = child(node, path.substr(pos + 1, end - pos - 1));
+            pos = end;
+        }
+        else if (path[pos] == '[')
+        {
+            size_t end = path.find(']', pos);
+            if (end == std::string::npos || end == pos + 1 ||
+                path.find_first_not_of("0123456789", pos + 1) != end)
+            {
+                throw std::runtime_error("Invalid array index in query path: " + path);
+            }
+            node = child(node, std::stoul(path.substr(pos + 1, end - pos - 1)));
+            pos = end + 1;
+        }
+        else
+        {
+            throw std::runtime_error("Query path steps must start with . or [: " + path);
+        }
+    }
+    return node;
+}
+
+size_t Query::child(size_t node, const std::string &key)
+{
+    for (const auto &entry : nodes[node].keys)
+    {
+        if (entry.first == key)
+        {
+            return entry.second;
+        }
+    }
+    nodes.push_back(Node());
+    nodes[node].keys.push_back({key, nodes.size() - 1});
+    return nodes.size() - 1;
+}
+
+size_t Query::child(size_t node, size_t index)
+{
+    for (const auto &entry : nodes[node].indices)
+    {
+        if (entry.first == index)
+        {
+            return entry.second;
+        }
+    }
+    nodes.push_back(Node());
+    nodes[node].indices.push_back({index, nodes.size() - 1});
+    return nodes.size() - 1;
+}
+
+bool Query::enterChild(const char *text, size_t length, size_t &pos, size_t &node)
+{
+    Frame &top = stack.back();
+    const Node &parent = nodes[top.node];
+    node = NONE;
+
+    if (!top.isObject)
+    {
+        for (const auto &entry : parent.indices)
+        {
+            if (entry.first == top.index)
+            {
+                node = entry.second;
+                break;
+            }
+        }
+        top.index++;
+        return true;
+    }
+
+    if (pos >= length || text[pos] != '"')
+    {
+        return false;
+    }
+    size_t keyEnd = scanString(text, length, pos);
+    if (keyEnd - pos < 2)
+    {
+        return false;
+    }
+    for (const auto &entry : parent.keys)
+    {
+        if (stringLiteralEquals(text, pos, keyEnd, entry.first))
+        {
+            node = entry.second;
+            break;
+        }
+    }
+
+    pos = scanWhitespace(text, length, keyEnd);
+    if (pos >= length || text[pos] != ':')
+    {
+        return false;
+    }
+    pos = scanWhitespace(text, length, pos + 1);
+    return true;
+}
+
+// True if the string literal text[begin, end) found by scanString ends in its
+// closing quote rather than at the end of the record
+static bool isClosedString(const char *text, size_t begin, size_t end)
+{
+    if (end - begin < 2 || text[end - 1] != '"')
+    {
+        return false;
+    }
+    size_t backslashes = 0;
+    while (end - 2 - backslashes > begin && text[end - 2 - backslashes] == '\\')
+    {
+        backslashes++;
+    }
+    return backslashes % 2 == 0;
+}
+
+// Walks the record with an explicit stack of the containers stepped into.
+// Values whose trie node has no children are skipped whole with scanValue.
+// A repeated member name replaces what was found under the earlier member.
+void Query::match(const char *text, size_t length, std::vector<Match> &matches)
+{
+    matches.assign(pathList.size(), Match());
+    stack.clear();
+
+    size_t pos = scanWhitespace(text, length, 0);
+    size_t node = 0;
+
+    while (true)
+    {
+        // A value starts at pos; node is the trie node it matched, if any
+        bool entered = false;
+        if (node != NONE && pos < length)
+        {
+            const Node &current = nodes[node];
+            for (size_t output : current.below)
+            {
+                matches[output] = Match();
+            }
+            if (!current.outputs.empty())
+            {
+                // Strings cut off by the end of the record are not matched
+                size_t end = scanValue(text, length, pos);
+                bool complete = text[pos] != '"' || isClosedString(text, pos, end);
+                for (size_t output : current.outputs)
+                {
+                    if (complete && end > pos)
+                    {
+                        matches[output] = {pos, end - pos};
+                    }
+                }
+            }
+
+            if ((text[pos] == '{' && !current.keys.empty()) || (text[pos] == '[' && !current.indices.empty()))
+            {
+                stack.push_back({node, text[pos] == '{', 0});
+                entered = true;
+            }
+        }
+
+        if (entered)
+        {
+            pos = scanWhitespace(text, length, pos + 1);
+            if (pos < length && text[pos] != (stack.back().isObject ? '}' : ']'))
+            {
+                if (!enterChild(text, length, pos, node))
+                {
+                    return;
+                }
+                continue;
+            }
+            pos++; // empty container
+            stack.pop_back();
+        }
+        else
+        {
+            pos = scanValue(text, length, pos);
+        }
+
+        // Move on to the next sibling, closing containers that are done
+        while (true)
+        {
+            if (stack.empty())
+            {
+                return;
+            }
+            pos = scanWhitespace(text, length, pos);
+            if (pos >= length)
+            {
+                return;
+            }
+            if (text[pos] == ',')
+            {
+                pos = scanWhitespace(text, length, pos + 1);
+                if (!enterChild(text, length, pos, node))
+                {
+                    return;
+                }
+                break;
+            }
+            if (text[pos] != (stack.back().isObject ? '}' : ']'))
+            {
+                return;
+            }
+            pos++;
+            stack.pop_back();
+        }
+    }
+}
+
+// Writes text as a TSV field, escaping what would break the line up
+static void writeTsvText(OutputBuffer &out, const std::string &text)
+{
+    size_t runStart = 0;
+    for (size_t i = 0; i < text.size(); i++)
+    {
+        const char *escape = nullptr;
+        switch (text[i])
+        {
+        case '\t':
+            escape = "\\t";
+            break;
+        case '\n':
+            escape = "\\n";
+            break;
+        case '\r':
+            escape = "\\r";
+            break;
+        case '\\':
+            escape = "\\\\";
+            break;
+        default:
+            continue;
+        }
+        out.write(text.data() + runStart, i - runStart);
+        out.write(escape, 2);
+        runStart = i + 1;
+    }
+    out.write(text.data() + runStart, text.size() - runStart);
+}
+
+// Containers are minified; scalars are copied as written
+static void writeCompact(OutputBuffer &out, const char *text, size_t length)
+{
+    if (text[0] == '{' || text[0] == '[')
+    {
+        FormatOptions options;
+        options.minify = true;
+        Lexer lexer(text, length);
+        Formatter(lexer, out, options).format();
+        return;
+    }
+    out.write(text, length);
+}
+
+void Query::write(const char *text, size_t length, QueryFormat format, OutputBuffer &out)
+{
+    Lexer lexer(text, length);
+    Parser parser(lexer);
+    parser.validate();
+    match(text, length, scratch);
+
+    // The line is built on the side, so a value that fails leaves out as it was
+    line.str().clear();
+    if (format == QueryFormat::JSON)
+    {
+        line.put('{');
+    }
+    for (size_t i = 0; i < scratch.size(); i++)
+    {
+        const Match &m = scratch[i];
+        const char *value = text + m.offset;
+
+        if (format == QueryFormat::JSON)
+        {
+            if (i > 0)
+            {
+                line.put(',');
+            }
+            writeJsonString(line, pathList[i]);
+            line.put(':');
+            if (m.length == 0)
+            {
+                line.write("null", 4);
+            }
+            else
+            {
+                writeCompact(line, value, m.length);
+            }
+            continue;
+        }
+
+        // TSV: missing values and nulls are empty fields, strings are decoded
+        if (i > 0)
+        {
+            line.put('\t');
+        }
+        if (m.length == 0 || (m.length == 4 && std::memcmp(value, "null", 4) == 0))
+        {
+            continue;
+        }
+        if (value[0] == '"')
+        {
+            writeTsvText(line, decodeStringLiteral(text, m.offset, m.offset + m.length));
+        }
+        else
+        {
+            writeCompact(line, value, m.length);
+        }
+    }
+    if (format == QueryFormat::JSON)
+    {
+        line.put('}');
+    }
+    line.put('\n');
+    out.write(line.str());
+}
+
+// A line with every value missing
+void Query::writeMissing(QueryFormat format, OutputBuffer &out) const
+{
+    if (format == QueryFormat::JSON)
+    {
+        out.put('{');
+    }
+    for (size_t i = 0; i < pathList.size(); i++)
+    {
+        if (format == QueryFormat::JSON)
+        {
+            if (i > 0)
+            {
+                out.put(',');
+            }
+            writeJsonString(out, pathList[i]);
+            out.write(":null", 5);
+        }
+        else if (i > 0)
+        {
+            out.put('\t');
+        }
+    }
+    if (format == QueryFormat::JSON)
+    {
+        out.put('}');
+    }
+    out.put('\n');
+}
+
+std::vector<Query::LineError> Query::writeLines(const char *text, size_t length, QueryFormat format,
+                                                OutputBuffer &out)
+{
+    std::vector<LineError> errors;
+    size_t lineNumber = 0;
+    size_t start = 0;
+    while (start < length)
+    {
+        const void *newline = std::memchr(text + start, '\n', length - start);
+        size_t end = newline != nullptr ? static_cast<const char *>(newline) - text : length;
+        lineNumber++;
+
+        if (scanWhitespace(text, end, start) < end)
+        {
+            try
+            {
+                write(text + start, end - start, format, out);
+            }
+            catch (const ParseError &e)
+            {
+                writeMissing(format, out);
+                errors.push_back({lineNumber, e.what()});
+            }
+        }
+        start = end + 1;
+    }
+    return errors;
+}
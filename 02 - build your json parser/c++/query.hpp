@@ -0,0 +1,97 @@
+#pragma once
+#include "output_buffer.hpp"
+#include <string>
+#include <utility>
+#include <vector>
+
+// Field projection over raw JSON records, e.g. pulling `.user.id` and
+// `.event.ts` out of every line of an NDJSON log. Records are walked with the
+// structural scan helpers: only the containers on the way to a requested
+// path are stepped into, every other subtree is skipped by bracket matching,
+// and no tokens or JsonValue nodes are created.
+//
+// write() and writeLines() check each record with Parser::validate before
+// extracting from it, which lexes the record but builds nothing. match()
+// alone trusts its input: malformed text never causes reads outside the
+// record, but the values found in it are unspecified.
+
+enum class QueryFormat
+{
+    TSV, // one line per record, values separated by tabs
+    JSON // one compact object per record, keyed by path
+};
+
+class Query
+{
+public:
+    // Where a path's value was found in a record; length is 0 if it was not
+    struct Match
+    {
+        size_t offset = 0;
+        size_t length = 0;
+    };
+
+    // paths is a comma separated list such as ".user.id,.tags[0]"; each path
+    // is a sequence of .key and [index] steps, and "." alone is the whole
+    // record. Throws std::runtime_error on a malformed path.
+    explicit Query(const std::string &paths);
+
+    const std::vector<std::string> &paths() const { return pathList; }
+
+    // Finds every path in the record text[0, length). matches gets one entry
+    // per path; if an object repeats a name the last member wins, as in
+    // JsonObject::find. Every member of a stepped-into object is looked at.
+    void match(const char *text, size_t length, std::vector<Match> &matches);
+
+    // A record writeLines could not write
+    struct LineError
+    {
+        size_t line; // 1-based line number in the NDJSON text
+        std::string message;
+    };
+
+    // Writes the requested values of one record as a line of output. Throws
+    // ParseError if the record is not valid JSON or a value cannot be
+    // written, and then writes nothing.
+    void write(const char *text, size_t length, QueryFormat format, OutputBuffer &out);
+
+    // Runs write for every non-blank line of NDJSON text. A record that
+    // fails is written with every value missing, so each input line still
+    // gives one output line, and is listed in the result.
+    std::vector<LineError> writeLines(const char *text, size_t length, QueryFormat format, OutputBuffer &out);
+
+private:
+    // Path trie: paths that share a prefix share the walk through it
+    struct Node
+    {
+        std::vector<std::pair<std::string, size_t>> keys; // member name -> node
+        std::vector<std::pair<size_t, size_t>> indices;   // element index -> node
+        std::vector<size_t> outputs;                      // paths ending here
+        std::vector<size_t> below;                        // paths ending here or deeper
+    };
+
+    static const size_t NONE = static_cast<size_t>(-1);
+
+    // A container being stepped through
+    struct Frame
+    {
+        size_t node;
+        bool isObject;
+        size_t index; // next element index for arrays
+    };
+
+    std::vector<std::string> pathList;
+    std::vector<Node> nodes; // nodes[0] is the root
+    std::vector<Frame> stack;
+    std::vector<Match> scratch;
+    OutputBuffer line; // write() output until the record is complete
+
+    size_t addPath(const std::string &path);
+    void writeMissing(QueryFormat format, OutputBuffer &out) const;
+    // Moves pos from the start of the next child of the container on top of
+    // the stack to the start of its value; node becomes the child's trie node
+    // (or NONE). Returns false if the text is malformed.
+    bool enterChild(const char *text, size_t length, size_t &pos, size_t &node);
+    size_t child(size_t node, const std::string &key);
+    size_t child(size_t node, size_t index);
+};
@@ -0,0 +1,397 @@
+#include "snapshot.hpp"
+#include <cstring>
+#include <stdexcept>
+#include <unordered_map>
+#include <vector>
+
+// Snapshot implementation
+bool Snapshot::open(const std::string &path)
+{
+    if (!file.open(path))
+    {
+        return false;
+    }
+    attach(file.data(), file.size());
+    return true;
+}
+
+void Snapshot::attach(const char *data, size_t size)
+{
+    if (size < sizeof(SnapshotHeader) || std::memcmp(data, "JSNP", 4) != 0)
+    {
+        throw std::runtime_error("Not a JSON snapshot");
+    }
+
+    header = reinterpret_cast<const SnapshotHeader *>(data);
+    if (header->version != VERSION)
+    {
+        throw std::runtime_error("Unsupported snapshot version");
+    }
+    if (header->byteOrder != ENDIAN_MARKER)
+    {
+        throw std::runtime_error("Snapshot was written with a different byte order");
+    }
+
+    // Check the section sizes against the file once, so accessors only need
+    // to bounds-check indices
+    uint64_t available = size - sizeof(SnapshotHeader);
+    if (header->nodeCount == 0 ||
+        header->nodeCount > available / sizeof(SnapshotNode) ||
+        header->childCount > (available - header->nodeCount * sizeof(SnapshotNode)) / sizeof(uint64_t) ||
+        header->stringsSize != available - header->nodeCount * sizeof(SnapshotNode) - header->childCount * sizeof(uint64_t))
+    {
+        throw std::runtime_error("Truncated or corrupt snapshot");
+    }
+
+    nodes = reinterpret_cast<const SnapshotNode *>(data + sizeof(SnapshotHeader));
+    children = reinterpret_cast<const uint64_t *>(nodes + header->nodeCount);
+    strings = reinterpret_cast<const char *>(children + header->childCount);
+}
+
+SnapshotValue Snapshot::root() const
+{
+    return SnapshotValue(this, nodeAt(0));
+}
+
+const SnapshotNode *Snapshot::nodeAt(uint64_t index) const
+{
+    if (header == nullptr || index >= header->nodeCount)
+    {
+        throw std::runtime_error("Snapshot node index out of range");
+    }
+    return nodes + index;
+}
+
+// SnapshotValue implementation
+JsonType SnapshotValue::type() const
+{
+    switch (node->type)
+    {
+    case SnapshotType::OBJECT:
+        return JsonType::OBJECT;
+    case SnapshotType::ARRAY:
+        return JsonType::ARRAY;
+    case SnapshotType::NUMBER:
+        return JsonType::NUMBER;
+    case SnapshotType::BOOLEAN:
+        return JsonType::BOOLEAN;
+    case SnapshotType::NULL_VALUE:
+        return JsonType::NULL_VALUE;
+    default:
+        return JsonType::STRING;
+    }
+}
+
+size_t SnapshotValue::size() const
+{
+    if (node->type != SnapshotType::OBJECT && node->type != SnapshotType::ARRAY)
+    {
+        return 0;
+    }
+    return node->count;
+}
+
+const SnapshotNode *SnapshotValue::child(size_t index) const
+{
+    uint64_t slot = node->payload + index;
+    if (slot >= snapshot->header->childCount)
+    {
+        throw std::runtime_error("Snapshot child index out of range");
+    }
+    uint64_t target = snapshot->children[slot];
+    if (target <= static_cast<uint64_t>(node - snapshot->nodes))
+    {
+        throw std::runtime_error("Snapshot child does not follow its container");
+    }
+    return snapshot->nodeAt(target);
+}
+
+SnapshotValue SnapshotValue::at(size_t index) const
+{
+    if (index >= size())
+    {
+        return SnapshotValue();
+    }
+    const SnapshotNode *target = child(index);
+    if (node->type == SnapshotType::OBJECT)
+    {
+        // Members point at their key; the value follows it
+        target = snapshot->nodeAt(target - snapshot->nodes + 1);
+    }
+    return SnapshotValue(snapshot, target);
+}
+
+std::string SnapshotValue::keyAt(size_t index) const
+{
+    if (node->type != SnapshotType::OBJECT || index >= size())
+    {
+        throw std::runtime_error("Snapshot member index out of range");
+    }
+    SnapshotValue key(snapshot, child(index));
+    return std::string(key.stringData(), key.node->count);
+}
+
+SnapshotValue SnapshotValue::find(const std::string &key) const
+{
+    if (node->type != SnapshotType::OBJECT)
+    {
+        return SnapshotValue();
+    }
+    for (size_t i = node->count; i-- > 0;)
+    {
+        SnapshotValue member(snapshot, child(i));
+        if (member.node->count == key.size() && std::memcmp(member.stringData(), key.data(), key.size()) == 0)
+        {
+            return at(i);
+        }
+    }
+    return SnapshotValue();
+}
+
+const char *SnapshotValue::stringData() const
+{
+    if (node->type != SnapshotType::STRING && node->type != SnapshotType::KEY)
+    {
+        throw std::runtime_error("Snapshot value is not a string");
+    }
+    if (node->payload > snapshot->header->stringsSize ||
+        node->count > snapshot->header->stringsSize - node->payload)
+    {
+        throw std::runtime_error("Snapshot string out of range");
+    }
+    return snapshot->strings + node->payload;
+}
+
+std::string SnapshotValue::asString() const
+{
+    return std::string(stringData(), node->count);
+}
+
+double SnapshotValue::asNumber() const
+{
+    if (node->type != SnapshotType::NUMBER)
+    {
+        throw std::runtime_error("Snapshot value is not a number");
+    }
+    double value;
+    std::memcpy(&value, &node->payload, sizeof(value));
+    return value;
+}
+
+bool SnapshotValue::asBool() const
+{
+    if (node->type != SnapshotType::BOOLEAN)
+    {
+        throw std::runtime_error("Snapshot value is not a boolean");
+    }
+    return node->payload != 0;
+}
+
+static JsonPtr makeScalar(const SnapshotValue &value)
+{
+    switch (value.type())
+    {
+    case JsonType::OBJECT:
+        return std::make_shared<JsonObject>();
+    case JsonType::ARRAY:
+        return std::make_shared<JsonArray>();
+    case JsonType::STRING:
+        return std::make_shared<JsonString>(value.asString());
+    case JsonType::NUMBER:
+        return std::make_shared<JsonNumber>(value.asNumber());
+    case JsonType::BOOLEAN:
+        return std::make_shared<JsonBoolean>(value.asBool());
+    default:
+        return std::make_shared<JsonNull>();
+    }
+}
+
+// Builds the tree with an explicit stack, like Parser::parseValue
+JsonPtr SnapshotValue::toJson() const
+{
+    struct Frame
+    {
+        SnapshotValue source;
+        JsonPtr target;
+        size_t next;
+    };
+
+    JsonPtr root = makeScalar(*this);
+    std::vector<Frame> stack;
+    if (size() > 0)
+    {
+        stack.push_back({*this, root, 0});
+    }
+
+    while (!stack.empty())
+    {
+        Frame &top = stack.back();
+        if (top.next == top.source.size())
+        {
+            stack.pop_back();
+            continue;
+        }
+
+        size_t index = top.next++;
+        SnapshotValue child = top.source.at(index);
+        JsonPtr value = makeScalar(child);
+
+        if (top.target->type == JsonType::OBJECT)
+        {
+            static_cast<JsonObject *>(top.target.get())->properties.push_back({top.source.keyAt(index), value});
+        }
+        else
+        {
+            static_cast<JsonArray *>(top.target.get())->elements.push_back(value);
+        }
+
+        if (child.size() > 0)
+        {
+            stack.push_back({child, value, 0}); // invalidates top
+        }
+    }
+    return root;
+}
+
+// Snapshot writer
+struct SnapshotWriter
+{
+    std::vector<SnapshotNode> nodes;
+    std::vector<uint64_t> children;
+    std::string strings;
+    std::unordered_map<std::string, uint64_t> stringOffsets;
+
+    SnapshotNode stringNode(SnapshotType type, const std::string &value)
+    {
+        if (value.size() > UINT32_MAX)
+        {
+            throw std::runtime_error("String too long for snapshot");
+        }
+        auto it = stringOffsets.find(value);
+        if (it == stringOffsets.end())
+        {
+            it = stringOffsets.emplace(value, strings.size()).first;
+            strings += value;
+        }
+        return {type, static_cast<uint32_t>(value.size()), it->second};
+    }
+
+    // Appends a node for value; containers reserve their children slots,
+    // which the caller fills in as the children are written
+    void add(const JsonValue &value)
+    {
+        SnapshotNode node = {SnapshotType::NULL_VALUE, 0, 0};
+        switch (value.type)
+        {
+        case JsonType::OBJECT:
+        case JsonType::ARRAY:
+        {
+            size_t count = value.type == JsonType::OBJECT
+                               ? static_cast<const JsonObject &>(value).properties.size()
+                               : static_cast<const JsonArray &>(value).elements.size();
+            if (count > UINT32_MAX)
+            {
+                throw std::runtime_error("Container too large for snapshot");
+            }
+            node.type = value.type == JsonType::OBJECT ? SnapshotType::OBJECT : SnapshotType::ARRAY;
+            node.count = static_cast<uint32_t>(count);
+            node.payload = children.size();
+            children.resize(children.size() + count);
+            break;
+        }
+        case JsonType::STRING:
+            node = stringNode(SnapshotType::STRING, static_cast<const JsonString &>(value).value);
+            break;
+        case JsonType::NUMBER:
+            node.type = SnapshotType::NUMBER;
+            std::memcpy(&node.payload, &static_cast<const JsonNumber &>(value).value, sizeof(double));
+            break;
+        case JsonType::BOOLEAN:
+            node.type = SnapshotType::BOOLEAN;
+            node.payload = static_cast<const JsonBoolean &>(value).value ? 1 : 0;
+            break;
+        case JsonType::NULL_VALUE:
+            break;
+        }
+        nodes.push_back(node);
+    }
+};
+
+void writeSnapshot(const JsonValue &root, std::ostream &out)
+{
+    struct Frame
+    {
+        const JsonValue *value;
+        uint64_t firstSlot;
+        size_t next;
+    };
+
+    SnapshotWriter writer;
+    std::vector<Frame> stack;
+
+    writer.add(root);
+    if (root.type == JsonType::OBJECT || root.type == JsonType::ARRAY)
+    {
+        stack.push_back({&root, writer.nodes.back().payload, 0});
+    }
+
+    while (!stack.empty())
+    {
+        Frame &top = stack.back();
+        const JsonValue *child;
+        uint64_t slot = top.firstSlot + top.next;
+
+        if (top.value->type == JsonType::OBJECT)
+        {
+            const auto &props = static_cast<const JsonObject *>(top.value)->properties;
+            if (top.next == props.size())
+            {
+                stack.pop_back();
+                continue;
+            }
+            writer.children[slot] = writer.nodes.size();
+            writer.nodes.push_back(writer.stringNode(SnapshotType::KEY, props[top.next].first.str()));
+            child = props[top.next].second.get();
+        }
+        else
+        {
+            const auto &elems = static_cast<const JsonArray *>(top.value)->elements;
+            if (top.next == elems.size())
+            {
+                stack.pop_back();
+                continue;
+            }
+            writer.children[slot] = writer.nodes.size();
+            child = elems[top.next].get();
+        }
+        top.next++;
+
+        writer.add(*child);
+        if (child->type == JsonType::OBJECT || child->type == JsonType::ARRAY)
+        {
+            stack.push_back({child, writer.nodes.back().payload, 0}); // invalidates top
+        }
+    }
+
+    // Pad the string table to keep the file size a multiple of 8
+    writer.strings.resize((writer.strings.size() + 7) & ~static_cast<size_t>(7), '\0');
+
+    SnapshotHeader header;
+    std::memcpy(header.magic, "JSNP", 4);
+    header.version = Snapshot::VERSION;
+    header.byteOrder = Snapshot::ENDIAN_MARKER;
+    header.reserved = 0;
+    header.nodeCount = writer.nodes.size();
+    header.childCount = writer.children.size();
+    header.stringsSize = writer.strings.size();
+
+    out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char *>(writer.nodes.data()), writer.nodes.size() * sizeof(SnapshotNode));
+    out.write(reinterpret_cast<const char *>(writer.children.data()), writer.children.size() * sizeof(uint64_t));
+    out.write(writer.strings.data(), writer.strings.size());
+    out.flush(); // so a full disk is noticed here rather than on close
+    if (!out)
+    {
+        throw std::runtime_error("Failed to write snapshot");
+    }
+}
@@ -0,0 +1,129 @@
+#pragma once
+#include "json_parser.hpp"
+#include "mapped_file.hpp"
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+// Binary snapshot of a parsed document that is read in place, without a
+// parse step. All integers are stored in the writer's native byte order; a
+// marker in the header makes readers on the other byte order reject the file.
+//
+// Layout (every section is 8-byte aligned):
+//
+//     SnapshotHeader
+//     SnapshotNode   nodes[nodeCount]     - node 0 is the root
+//     uint64_t       children[childCount] - node indices, one run per container
+//     char           strings[stringsSize] - deduplicated string bytes
+//
+// Arrays list their elements in `children`; objects list the key node of each
+// member, and the member's value is the node right after its key. Children
+// always come after their container, which readers check so that a corrupt
+// file cannot make a container contain itself.
+
+class Snapshot;
+
+struct SnapshotHeader
+{
+    char magic[4]; // "JSNP"
+    uint32_t version;
+    uint32_t byteOrder; // Snapshot::ENDIAN_MARKER as written
+    uint32_t reserved;
+    uint64_t nodeCount;
+    uint64_t childCount;
+    uint64_t stringsSize;
+};
+
+enum class SnapshotType : uint32_t
+{
+    OBJECT,
+    ARRAY,
+    STRING,
+    NUMBER,
+    BOOLEAN,
+    NULL_VALUE,
+    KEY // object member key, followed by the member's value
+};
+
+struct SnapshotNode
+{
+    SnapshotType type;
+    uint32_t count;   // children of a container, bytes of a string or key
+    uint64_t payload; // first children slot, string offset, double bits or bool
+};
+
+// Handle to one value inside a Snapshot. Handles are cheap to copy and stay
+// valid as long as the snapshot's bytes. A default constructed handle, or the
+// result of a failed lookup, is "missing" and converts to false.
+class SnapshotValue
+{
+public:
+    SnapshotValue() = default;
+
+    explicit operator bool() const { return node != nullptr; }
+    JsonType type() const;
+
+    // Number of elements or members of a container
+    size_t size() const;
+
+    // Array element, or the value of the index'th object member
+    SnapshotValue at(size_t index) const;
+    // Key of the index'th object member
+    std::string keyAt(size_t index) const;
+    // Value of the object member named key; the last one if it repeats
+    SnapshotValue find(const std::string &key) const;
+
+    // Scalar accessors; throw if the value has another type. stringData()
+    // points into the snapshot itself and is not null-terminated.
+    const char *stringData() const;
+    std::string asString() const;
+    double asNumber() const;
+    bool asBool() const;
+
+    // Rebuilds this value as a JsonValue tree
+    JsonPtr toJson() const;
+
+private:
+    friend class Snapshot;
+
+    const Snapshot *snapshot = nullptr;
+    const SnapshotNode *node = nullptr;
+
+    SnapshotValue(const Snapshot *snapshot, const SnapshotNode *node) : snapshot(snapshot), node(node) {}
+
+    const SnapshotNode *child(size_t index) const;
+};
+
+class Snapshot
+{
+public:
+    static const uint32_t VERSION = 1;
+    static const uint32_t ENDIAN_MARKER = 0x01020304;
+
+    Snapshot() = default;
+
+    Snapshot(const Snapshot &) = delete;
+    Snapshot &operator=(const Snapshot &) = delete;
+
+    // Maps a snapshot file; returns false if it cannot be read
+    bool open(const std::string &path);
+    // Uses bytes owned by the caller, which must outlive the snapshot and be
+    // 8-byte aligned
+    void attach(const char *data, size_t size);
+
+    SnapshotValue root() const;
+
+private:
+    friend class SnapshotValue;
+
+    MappedFile file;
+    const SnapshotHeader *header = nullptr;
+    const SnapshotNode *nodes = nullptr;
+    const uint64_t *children = nullptr;
+    const char *strings = nullptr;
+
+    const SnapshotNode *nodeAt(uint64_t index) const;
+};
+
+// Writes root in snapshot format; throws std::runtime_error on failure
+void writeSnapshot(const JsonValue &root, std::ostream &out);
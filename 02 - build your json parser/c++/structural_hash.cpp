@@ -0,0 +1,484 @@
+#include "structural_hash.hpp"
+#include <algorithm>
+#include <cstring>
+
+// Distinct seeds so values of different types never hash alike by accident
+static const uint64_t OBJECT_SEED = 0x6f626a6563740001ull;
+static const uint64_t ARRAY_SEED = 0x6172726179000002ull;
+static const uint64_t STRING_SEED = 0x737472696e670003ull;
+static const uint64_t NUMBER_SEED = 0x6e756d6265720004ull;
+static const uint64_t BOOLEAN_SEED = 0x626f6f6c00000005ull;
+static const uint64_t NULL_SEED = 0x6e756c6c00000006ull;
+
+// Finalizer from splitmix64: spreads every input bit over the whole result
+static uint64_t mix(uint64_t x)
+{
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ull;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebull;
+    x ^= x >> 31;
+    return x;
+}
+
+// 64-bit FNV-1a
+static uint64_t hashText(const char *data, size_t size)
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < size; i++)
+    {
+        h ^= static_cast<unsigned char>(data[i]);
+        h *= 0x100000001b3ull;
+    }
+    return h;
+}
+
+static bool isContainer(const JsonValue &value)
+{
+    return value.type == JsonType::OBJECT || value.type == JsonType::ARRAY;
+}
+
+static size_t childCount(const JsonValue &value)
+{
+    if (value.type == JsonType::OBJECT)
+    {
+        return static_cast<const JsonObject &>(value).properties.size();
+    }
+    if (value.type == JsonType::ARRAY)
+    {
+        return static_cast<const JsonArray &>(value).elements.size();
+    }
+    return 0;
+}
+
+static JsonPtr &childAt(JsonValue &value, size_t index)
+{
+    if (value.type == JsonType::OBJECT)
+    {
+        return static_cast<JsonObject &>(value).properties[index].second;
+    }
+    return static_cast<JsonArray &>(value).elements[index];
+}
+
+static const JsonValue *childAt(const JsonValue &value, size_t index)
+{
+    return childAt(const_cast<JsonValue &>(value), index).get();
+}
+
+const uint64_t *HashCache::cached(const JsonValue &value, bool ignoreKeyOrder) const
+{
+    auto found = entries.find(&value);
+    if (found == entries.end() || !found->second.known[ignoreKeyOrder])
+    {
+        return nullptr;
+    }
+    return &found->second.value[ignoreKeyOrder];
+}
+
+// Hashes a subtree bottom-up. A node is only combined once all of its
+// children have a hash of the wanted kind; scalars hash the same either way,
+// so both kinds are stored for them at once.
+uint64_t HashCache::hash(const JsonValue &value, bool ignoreKeyOrder)
+{
+    if (const uint64_t *known = cached(value, ignoreKeyOrder))
+    {
+        return *known;
+    }
+    auto childHash = [&](const JsonPtr &child) { return *cached(*child, ignoreKeyOrder); };
+
+    struct Frame
+    {
+        const JsonValue *node;
+        size_t next; // index of the next child to check
+    };
+    std::vector<Frame> stack;
+    stack.push_back({&value, 0});
+
+    while (!stack.empty())
+    {
+        Frame &top = stack.back();
+        const JsonValue &node = *top.node;
+
+        if (top.next < childCount(node))
+        {
+            const JsonValue *child = childAt(node, top.next++);
+            if (cached(*child, ignoreKeyOrder) == nullptr)
+            {
+                stack.push_back({child, 0});
+            }
+            continue;
+        }
+
+        uint64_t h = 0;
+        switch (node.type)
+        {
+        case JsonType::OBJECT:
+        {
+            const auto &properties = static_cast<const JsonObject &>(node).properties;
+            if (ignoreKeyOrder)
+            {
+                // Addition is commutative, so member order does not matter
+                uint64_t sum = 0;
+                for (const auto &prop : properties)
+                {
+                    sum += mix(hashText(prop.first.data(), prop.first.size()) ^ mix(childHash(prop.second)));
+                }
+                h = mix(OBJECT_SEED ^ sum);
+            }
+            else
+            {
+                h = OBJECT_SEED;
+                for (const auto &prop : properties)
+                {
+                    h = mix(h ^ mix(hashText(prop.first.data(), prop.first.size()) ^ mix(childHash(prop.second))));
+                }
+            }
+            h = mix(h + properties.size());
+            break;
+        }
+        case JsonType::ARRAY:
+        {
+            const auto &elements = static_cast<const JsonArray &>(node).elements;
+            h = ARRAY_SEED;
+            for (const auto &elem : elements)
+            {
+                h = mix(h ^ childHash(elem));
+            }
+            h = mix(h + elements.size());
+            break;
+        }
+        case JsonType::STRING:
+        {
+            const std::string &text = static_cast<const JsonString &>(node).value;
+            h = mix(STRING_SEED ^ hashText(text.data(), text.size()));
+            break;
+        }
+        case JsonType::NUMBER:
+        {
+            // -0 and 0 compare equal, so they must hash alike
+            double value = static_cast<const JsonNumber &>(node).value;
+            if (value == 0)
+            {
+                value = 0;
+            }
+            uint64_t bits;
+            std::memcpy(&bits, &value, sizeof(bits));
+            h = mix(NUMBER_SEED ^ bits);
+            break;
+        }
+        case JsonType::BOOLEAN:
+            h = mix(BOOLEAN_SEED + static_cast<const JsonBoolean &>(node).value);
+            break;
+        case JsonType::NULL_VALUE:
+            h = mix(NULL_SEED);
+            break;
+        }
+
+        Entry &entry = entries[&node];
+        entry.value[ignoreKeyOrder] = h;
+        entry.known[ignoreKeyOrder] = true;
+        if (!isContainer(node))
+        {
+            entry.value[!ignoreKeyOrder] = h;
+            entry.known[!ignoreKeyOrder] = true;
+        }
+        stack.pop_back();
+    }
+    return *cached(value, ignoreKeyOrder);
+}
+
+// Compares the text of two keys, which may be interned in different tables
+static bool sameKey(const JsonKey &a, const JsonKey &b)
+{
+    return a.size() == b.size() && std::memcmp(a.data(), b.data(), a.size()) == 0;
+}
+
+// Member positions of obj sorted by key; stable, so duplicates keep their order
+static std::vector<size_t> keyOrder(const JsonObject &obj)
+{
+    std::vector<size_t> order(obj.properties.size());
+    for (size_t i = 0; i < order.size(); i++)
+    {
+        order[i] = i;
+    }
+    std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b)
+                     { return obj.properties[a].first < obj.properties[b].first; });
+    return order;
+}
+
+bool deepEquals(const JsonValue &a, const JsonValue &b, bool ignoreKeyOrder)
+{
+    HashCache cache;
+    return deepEquals(a, b, ignoreKeyOrder, cache);
+}
+
+bool deepEquals(const JsonValue &a, const JsonValue &b, bool ignoreKeyOrder, HashCache &cache)
+{
+    std::vector<std::pair<const JsonValue *, const JsonValue *>> pending;
+    pending.push_back({&a, &b});
+
+    while (!pending.empty())
+    {
+        const JsonValue *x = pending.back().first;
+        const JsonValue *y = pending.back().second;
+        pending.pop_back();
+
+        if (x == y)
+        {
+            continue;
+        }
+        if (x->type != y->type || cache.hash(*x, ignoreKeyOrder) != cache.hash(*y, ignoreKeyOrder))
+        {
+            return false;
+        }
+
+        switch (x->type)
+        {
+        case JsonType::OBJECT:
+        {
+            const auto &left = static_cast<const JsonObject &>(*x);
+            const auto &right = static_cast<const JsonObject &>(*y);
+            if (left.properties.size() != right.properties.size())
+            {
+                return false;
+            }
+
+            std::vector<size_t> leftOrder, rightOrder;
+            if (ignoreKeyOrder)
+            {
+                leftOrder = keyOrder(left);
+                rightOrder = keyOrder(right);
+            }
+            for (size_t i = 0; i < left.properties.size(); i++)
+            {
+                const auto &l = left.properties[ignoreKeyOrder ? leftOrder[i] : i];
+                const auto &r = right.properties[ignoreKeyOrder ? rightOrder[i] : i];
+                if (!sameKey(l.first, r.first))
+                {
+                    return false;
+                }
+                pending.push_back({l.second.get(), r.second.get()});
+            }
+            break;
+        }
+        case JsonType::ARRAY:
+        {
+            const auto &left = static_cast<const JsonArray &>(*x).elements;
+            const auto &right = static_cast<const JsonArray &>(*y).elements;
+            if (left.size() != right.size())
+            {
+                return false;
+            }
+            for (size_t i = 0; i < left.size(); i++)
+            {
+                pending.push_back({left[i].get(), right[i].get()});
+            }
+            break;
+        }
+        case JsonType::STRING:
+            if (static_cast<const JsonString &>(*x).value != static_cast<const JsonString &>(*y).value)
+            {
+                return false;
+            }
+            break;
+        case JsonType::NUMBER:
+            if (static_cast<const JsonNumber &>(*x).value != static_cast<const JsonNumber &>(*y).value)
+            {
+                return false;
+            }
+            break;
+        case JsonType::BOOLEAN:
+            if (static_cast<const JsonBoolean &>(*x).value != static_cast<const JsonBoolean &>(*y).value)
+            {
+                return false;
+            }
+            break;
+        case JsonType::NULL_VALUE:
+            break;
+        }
+    }
+    return true;
+}
+
+// DedupTable implementation
+JsonPtr DedupTable::lookup(const JsonPtr &value)
+{
+    uint64_t h = hashes.hash(*value);
+    auto range = nodes.equal_range(h);
+    for (auto it = range.first; it != range.second; ++it)
+    {
+        if (deepEquals(*it->second, *value, false, hashes))
+        {
+            // value may be freed once replaced, so its hash must not stay
+            hashes.invalidate(*value);
+            return it->second;
+        }
+    }
+    nodes.insert({h, value});
+    return value;
+}
+
+// Post-order walk: a container is looked up only after each of its children
+// was replaced by its shared copy, so comparing two candidates stops at
+// pointer-equal children instead of walking whole subtrees again, and the
+// container is hashed from the hashes its shared children already have.
+JsonPtr DedupTable::intern(const JsonPtr &root)
+{
+    if (!root)
+    {
+        return root;
+    }
+    if (!isContainer(*root))
+    {
+        return lookup(root);
+    }
+
+    struct Frame
+    {
+        JsonPtr node;
+        size_t next; // index of the next child to intern
+    };
+    std::vector<Frame> stack;
+    stack.push_back({root, 0});
+
+    while (true)
+    {
+        Frame &top = stack.back();
+        if (top.next < childCount(*top.node))
+        {
+            JsonPtr &child = childAt(*top.node, top.next++);
+            if (isContainer(*child))
+            {
+                JsonPtr next = child;
+                stack.push_back({std::move(next), 0});
+            }
+            else
+            {
+                child = lookup(child);
+            }
+            continue;
+        }
+
+        JsonPtr shared = lookup(top.node);
+        stack.pop_back();
+        if (stack.empty())
+        {
+            return shared;
+        }
+        Frame &parent = stack.back();
+        childAt(*parent.node, parent.next - 1) = std::move(shared);
+    }
+}
+
+// Appends key to a JSON Pointer, escaping ~ and / as RFC 6901 requires
+static std::string childPath(const std::string &path, const std::string &key)
+{
+    std::string result = path + "/";
+    for (char c : key)
+    {
+        if (c == '~')
+        {
+            result += "~0";
+        }
+        else if (c == '/')
+        {
+            result += "~1";
+        }
+        else
+        {
+            result += c;
+        }
+    }
+    return result;
+}
+
+// True unless a later member of obj has the same key as member i
+static bool isLastWithKey(const JsonObject &obj, size_t i)
+{
+    return obj.find(obj.properties[i].first.str()) == obj.properties[i].second;
+}
+
+std::vector<JsonDifference> diffJson(const JsonPtr &before, const JsonPtr &after)
+{
+    HashCache cache;
+    return diffJson(before, after, cache);
+}
+
+std::vector<JsonDifference> diffJson(const JsonPtr &before, const JsonPtr &after, HashCache &cache)
+{
+    struct Pending
+    {
+        std::string path;
+        JsonPtr before;
+        JsonPtr after;
+    };
+    std::vector<JsonDifference> differences;
+    std::vector<Pending> pending;
+    std::vector<Pending> children;
+    pending.push_back({"", before, after});
+
+    while (!pending.empty())
+    {
+        Pending item = std::move(pending.back());
+        pending.pop_back();
+
+        if (!item.before || !item.after)
+        {
+            if (item.before || item.after)
+            {
+                auto kind = item.before ? JsonDifference::Kind::REMOVED : JsonDifference::Kind::ADDED;
+                differences.push_back({kind, item.path, item.before, item.after});
+            }
+            continue;
+        }
+        if (item.before == item.after || cache.hash(*item.before, true) == cache.hash(*item.after, true))
+        {
+            continue;
+        }
+
+        children.clear();
+        if (item.before->type == JsonType::OBJECT && item.after->type == JsonType::OBJECT)
+        {
+            const auto &left = static_cast<const JsonObject &>(*item.before);
+            const auto &right = static_cast<const JsonObject &>(*item.after);
+            for (size_t i = 0; i < left.properties.size(); i++)
+            {
+                if (isLastWithKey(left, i))
+                {
+                    std::string key = left.properties[i].first.str();
+                    children.push_back({childPath(item.path, key), left.properties[i].second, right.find(key)});
+                }
+            }
+            for (size_t i = 0; i < right.properties.size(); i++)
+            {
+                std::string key = right.properties[i].first.str();
+                if (isLastWithKey(right, i) && !left.find(key))
+                {
+                    children.push_back({childPath(item.path, key), nullptr, right.properties[i].second});
+                }
+            }
+        }
+        else if (item.before->type == JsonType::ARRAY && item.after->type == JsonType::ARRAY)
+        {
+            const auto &left = static_cast<const JsonArray &>(*item.before).elements;
+            const auto &right = static_cast<const JsonArray &>(*item.after).elements;
+            for (size_t i = 0; i < std::max(left.size(), right.size()); i++)
+            {
+                children.push_back({item.path + "/" + std::to_string(i), i < left.size() ? left[i] : nullptr,
+                                    i < right.size() ? right[i] : nullptr});
+            }
+        }
+        else
+        {
+            differences.push_back({JsonDifference::Kind::CHANGED, item.path, item.before, item.after});
+            continue;
+        }
+
+        // Reversed so the first child is visited next, keeping document order
+        for (size_t i = children.size(); i-- > 0;)
+        {
+            pending.push_back(std::move(children[i]));
+        }
+    }
+    return differences;
+}
@@ -0,0 +1,100 @@
+#pragma once
+#include "json_parser.hpp"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// Structural hashing of JsonValue trees. A node's hash combines the hashes
+// of its children, so after one pass over a tree every subtree has its hash
+// and two subtrees can be told apart in O(1).
+//
+// Every function here walks trees with an explicit stack, so deeply nested
+// documents are safe.
+
+// Structural hashes of subtrees, kept beside the trees rather than in them.
+// Deep-equal values hash the same; with ignoreKeyOrder, so do objects that
+// differ only in member order. Both kinds are cached per node, so mixing
+// them costs nothing extra.
+//
+// Nodes are identified by address and the cache holds no reference to them:
+// clear() it before a tree it has hashed is freed, and after changing a
+// node, invalidate() it and each of its ancestors. A cache is not
+// thread-safe; give each thread its own.
+class HashCache
+{
+private:
+    struct Entry
+    {
+        uint64_t value[2]; // indexed by ignoreKeyOrder
+        bool known[2];
+    };
+    std::unordered_map<const JsonValue *, Entry> entries;
+
+    const uint64_t *cached(const JsonValue &value, bool ignoreKeyOrder) const;
+
+public:
+    uint64_t hash(const JsonValue &value, bool ignoreKeyOrder = false);
+
+    void invalidate(const JsonValue &value) { entries.erase(&value); }
+    size_t size() const { return entries.size(); }
+    void clear() { entries.clear(); }
+};
+
+// Exact deep equality. Different hashes and shared (pointer-equal) subtrees
+// are decided without looking inside them. With ignoreKeyOrder, object
+// members are compared in key order; duplicate keys keep their input order.
+// Pass a cache to keep the hashes for later comparisons of the same trees.
+bool deepEquals(const JsonValue &a, const JsonValue &b, bool ignoreKeyOrder = false);
+bool deepEquals(const JsonValue &a, const JsonValue &b, bool ignoreKeyOrder, HashCache &cache);
+
+// Shares identical subtrees. intern() rewrites a tree so that every subtree
+// equal to one seen before (in this tree or in any tree interned earlier) is
+// replaced by the first copy, and returns the replacement for the root.
+// Equality here includes member order.
+//
+// The table holds a reference to every distinct subtree it has seen, so they
+// stay alive until clear(). Once shared, a node may belong to several
+// documents, so interned trees should be treated as read-only.
+class DedupTable
+{
+private:
+    std::unordered_multimap<uint64_t, JsonPtr> nodes;
+    HashCache hashes; // safe to keep, since nodes keeps every hashed node alive
+
+    JsonPtr lookup(const JsonPtr &value);
+
+public:
+    JsonPtr intern(const JsonPtr &root);
+
+    size_t size() const { return nodes.size(); }
+    void clear()
+    {
+        nodes.clear();
+        hashes.clear();
+    }
+};
+
+struct JsonDifference
+{
+    enum class Kind
+    {
+        ADDED,   // only in the new document
+        REMOVED, // only in the old document
+        CHANGED  // in both, with different values
+    };
+
+    Kind kind;
+    std::string path; // RFC 6901 JSON Pointer, "" for the root
+    JsonPtr before;   // nullptr when ADDED
+    JsonPtr after;    // nullptr when REMOVED
+};
+
+// Lists what changed between two documents, in document order. Objects are
+// matched by key (member order is ignored; a duplicate key means its last
+// member, as with find) and arrays by index. Branches whose key-order
+// independent hashes match are skipped without being visited, so once both
+// trees are hashed in cache the cost depends on the size of the changes
+// rather than of the documents. A 64-bit hash makes a false match vanishingly
+// unlikely, but it is not checked; use deepEquals when that matters.
+std::vector<JsonDifference> diffJson(const JsonPtr &before, const JsonPtr &after);
+std::vector<JsonDifference> diffJson(const JsonPtr &before, const JsonPtr &after, HashCache &cache);
@@ -0,0 +1,123 @@
+#include "structural_scan.hpp"
+#include "json_parser.hpp"
+#include <cstring>
+
+static bool isWhitespace(char c)
+{
+    // Same set as std::isspace in the "C" locale, which the Lexer uses
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
+
+size_t scanWhitespace(const char *text, size_t length, size_t pos)
+{
+    while (pos < length && isWhitespace(text[pos]))
+    {
+        pos++;
+    }
+    return pos;
+}
+
+size_t scanString(const char *text, size_t length, size_t pos)
+{
+    pos++; // Skip opening quote
+
+    while (pos < length)
+    {
+        // Jump straight to the next quote, then check whether it is escaped
+        // by an odd run of backslashes
+        const void *quote = std::memchr(text + pos, '"', length - pos);
+        if (quote == nullptr)
+        {
+            return length;
+        }
+        size_t end = static_cast<const char *>(quote) - text;
+
+        size_t backslashes = 0;
+        while (end - backslashes > pos && text[end - backslashes - 1] == '\\')
+        {
+            backslashes++;
+        }
+        pos = end + 1;
+        if (backslashes % 2 == 0)
+        {
+            return pos;
+        }
+    }
+    return length;
+}
+
+size_t scanValue(const char *text, size_t length, size_t pos)
+{
+    if (pos >= length)
+    {
+        return length;
+    }
+
+    char first = text[pos];
+    if (first == '"')
+    {
+        return scanString(text, length, pos);
+    }
+
+    if (first != '{' && first != '[')
+    {
+        // Number or keyword: runs until a delimiter
+        while (pos < length && !isWhitespace(text[pos]) && text[pos] != ',' &&
+               text[pos] != '}' && text[pos] != ']' && text[pos] != ':')
+        {
+            pos++;
+        }
+        return pos;
+    }
+
+    // Container: count brackets until the matching close, stepping over
+    // strings so brackets inside them are ignored
+    size_t depth = 0;
+    while (pos < length)
+    {
+        switch (text[pos])
+        {
+        case '"':
+            pos = scanString(text, length, pos);
+            continue;
+        case '{':
+        case '[':
+            depth++;
+            break;
+        case '}':
+        case ']':
+            if (--depth == 0)
+            {
+                return pos + 1;
+            }
+            break;
+        default:
+            break;
+        }
+        pos++;
+    }
+    return length;
+}
+
+// Literals without escapes are copied as they are; the rest go through the
+// Lexer
+std::string decodeStringLiteral(const char *text, size_t begin, size_t end)
+{
+    if (std::memchr(text + begin, '\\', end - begin) == nullptr)
+    {
+        return std::string(text + begin + 1, end - begin - 2);
+    }
+    Lexer lexer(text + begin, end - begin);
+    return lexer.getNextToken().value;
+}
+
+bool stringLiteralEquals(const char *text, size_t begin, size_t end, const std::string &value)
+{
+    size_t rawLength = end - begin - 2;
+    if (std::memchr(text + begin, '\\', end - begin) == nullptr)
+    {
+        return rawLength == value.size() && std::memcmp(text + begin + 1, value.data(), rawLength) == 0;
+    }
+    // An escaped literal decodes to at most as many bytes as it has in the source
+    return value.size() <= rawLength && decodeStringLiteral(text, begin, end) == value;
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <cstddef>
+#include <string>
+
+// Structural scanning over raw JSON text. These helpers only match brackets
+// and quotes; they assume the text was already validated (or that the caller
+// does not need errors) and never build tokens or nodes. All of them take the
+// offset of the first byte to look at and return the offset just past what
+// they skipped, or `length` if the text ends first.
+
+// Skips JSON whitespace
+size_t scanWhitespace(const char *text, size_t length, size_t pos);
+
+// Skips a string; pos must be at its opening quote
+size_t scanString(const char *text, size_t length, size_t pos);
+
+// Skips one complete value of any type; pos must be at its first byte
+size_t scanValue(const char *text, size_t length, size_t pos);
+
+// Decodes the string literal text[begin, end) (quotes included), e.g. a
+// range found with scanString
+std::string decodeStringLiteral(const char *text, size_t begin, size_t end);
+
+// Compares the string literal text[begin, end) against already decoded text
+bool stringLiteralEquals(const char *text, size_t begin, size_t end, const std::string &value);
@@ -0,0 +1,193 @@
+// bind_check - JSON_BIND round trips and rejected input
+//
+// Writes bound structs, reads them back and compares, then feeds malformed
+// documents and out-of-range numbers that must be rejected.
+//
+// Exits with status 1 and prints what failed on the first failure.
+
+#include "json_bind.hpp"
+#include <cmath>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+struct Address
+{
+    std::string city;
+    int zip = 0;
+};
+JSON_BIND(Address, city, zip)
+
+struct Record
+{
+    std::string name;
+    bool active = false;
+    int small = 0;
+    long long big = 0;
+    unsigned long long id = 0;
+    float ratio = 0;
+    double score = 0;
+    std::vector<std::string> tags;
+    std::vector<Address> addresses;
+};
+JSON_BIND(Record, name, active, small, big, id, ratio, score, tags, addresses)
+
+static bool fail(const std::string &what, const std::string &text)
+{
+    std::cout << "FAIL: " << what << "\n" << text << "\n";
+    return false;
+}
+
+static bool sameRecord(const Record &a, const Record &b)
+{
+    if (a.name != b.name || a.active != b.active || a.small != b.small || a.big != b.big || a.id != b.id ||
+        a.ratio != b.ratio || a.score != b.score || a.tags != b.tags || a.addresses.size() != b.addresses.size())
+    {
+        return false;
+    }
+    for (size_t i = 0; i < a.addresses.size(); i++)
+    {
+        if (a.addresses[i].city != b.addresses[i].city || a.addresses[i].zip != b.addresses[i].zip)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// True if text is rejected with a ParseError
+static bool rejects(const std::string &text)
+{
+    try
+    {
+        fromJson<Record>(text);
+    }
+    catch (const ParseError &)
+    {
+        return true;
+    }
+    return false;
+}
+
+static bool checkRoundTrip()
+{
+    Record record;
+    record.name = "Ann \"Q\"\n\t\\";
+    record.active = true;
+    record.small = -2147483647 - 1;
+    record.big = std::numeric_limits<long long>::min();
+    record.id = std::numeric_limits<unsigned long long>::max();
+    record.ratio = 0.1f;
+    record.score = 0.1;
+    record.tags = {"x", "", "\xc3\xa9"};
+    record.addresses = {{"Oslo", 123}, {"", 0}};
+
+    std::string text = toJson(record);
+    if (text.find("\"ratio\":0.100000001") == std::string::npos)
+    {
+        return fail("float not written with float precision", text);
+    }
+    Record back = fromJson<Record>(text);
+    if (!sameRecord(record, back))
+    {
+        return fail("round trip changed the record", text);
+    }
+    if (toJson(back) != text)
+    {
+        return fail("second write differs", toJson(back));
+    }
+
+    // Non-finite values are written as null, which reading leaves alone
+    Record special;
+    special.ratio = std::numeric_limits<float>::infinity();
+    special.score = std::nan("");
+    text = toJson(special);
+    if (text.find("\"ratio\":null") == std::string::npos || text.find("\"score\":null") == std::string::npos)
+    {
+        return fail("non-finite numbers not written as null", text);
+    }
+    Record read;
+    read.ratio = 2;
+    read.score = 5;
+    Lexer lexer(text);
+    fromJson(lexer, read);
+    if (read.ratio != 2 || read.score != 5)
+    {
+        return fail("null did not keep the default", text);
+    }
+    return true;
+}
+
+static bool checkNumbers()
+{
+    Record record = fromJson<Record>(R"({"score":5e-324,"ratio":1e-50,"big":-0})");
+    if (record.score != 5e-324 || record.ratio != 0 || record.big != 0)
+    {
+        return fail("small numbers not read", toJson(record));
+    }
+    record = fromJson<Record>(R"({"score":-0})");
+    if (record.score != 0 || !std::signbit(record.score))
+    {
+        return fail("-0 lost its sign", toJson(record));
+    }
+
+    const char *outOfRange[] = {
+        R"({"score":1e400})",
+        R"({"ratio":1e39})",
+        R"({"small":2147483648})",
+        R"({"big":9223372036854775808})",
+        R"({"id":-1})",
+        R"({"id":18446744073709551616})",
+        R"({"small":1.5})",
+    };
+    for (const char *text : outOfRange)
+    {
+        if (!rejects(text))
+        {
+            return fail("out of range number accepted", text);
+        }
+    }
+    return true;
+}
+
+static bool checkMalformed()
+{
+    // Unknown members are skipped, but their syntax is still checked
+    Record record = fromJson<Record>(R"({"junk":{"a":[1,{"b":null},[]],"c":"}"},"small":7,"more":[[],{}]})");
+    if (record.small != 7)
+    {
+        return fail("member after skipped values not read", toJson(record));
+    }
+
+    const char *malformed[] = {
+        R"({"zz":,,"small":3})",
+        R"({"zz": :, "small":5})",
+        R"({"zz":[1,,}, "small":4})",
+        R"({"zz":[1,]})",
+        R"({"zz":{"a":1,}})",
+        R"({"zz":{"a" 1}})",
+        R"({"zz":[})",
+        R"({"small":1,})",
+        R"({"small":1} x)",
+        R"([1])",
+    };
+    for (const char *text : malformed)
+    {
+        if (!rejects(text))
+        {
+            return fail("malformed document accepted", text);
+        }
+    }
+    return true;
+}
+
+int main()
+{
+    if (!checkRoundTrip() || !checkNumbers() || !checkMalformed())
+    {
+        return 1;
+    }
+    std::cout << "ok\n";
+    return 0;
+}
@@ -0,0 +1,171 @@
+// columnar_check - parseColumnar schemas, type changes and rejected input
+//
+// Reads arrays of objects into columns and compares each column, row by row,
+// with the expected values; then feeds input that must be rejected.
+//
+// Exits with status 1 and prints what failed on the first failure.
+
+#include "columnar.hpp"
+#include <cmath>
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+static ColumnarTable read(const std::string &text)
+{
+    return parseColumnar(text.data(), text.size());
+}
+
+static bool fail(const std::string &what, const std::string &text)
+{
+    std::cout << "FAIL: " << what << "\n" << text << "\n";
+    return false;
+}
+
+// The column's rows written out, e.g. "1 null 2.5" or "[x] null"
+static std::string describe(const ColumnarTable &table, const std::string &name)
+{
+    const Column *column = table.column(name);
+    if (column == nullptr)
+    {
+        return "no column";
+    }
+    std::string result;
+    for (size_t row = 0; row < table.rows; row++)
+    {
+        if (row > 0)
+        {
+            result += " ";
+        }
+        if (column->isNull(row))
+        {
+            result += "null";
+        }
+        else if (column->type == ColumnType::NUMBER)
+        {
+            char buffer[32];
+            std::snprintf(buffer, sizeof(buffer), "%g", column->number(row));
+            result += buffer;
+        }
+        else if (column->type == ColumnType::BOOLEAN)
+        {
+            result += column->boolean(row) ? "true" : "false";
+        }
+        else
+        {
+            result += "[" + column->text(row) + "]";
+        }
+    }
+    return result;
+}
+
+static bool expectColumn(const ColumnarTable &table, const std::string &name, ColumnType type,
+                         const std::string &rows)
+{
+    const Column *column = table.column(name);
+    if (column == nullptr || column->type != type || describe(table, name) != rows)
+    {
+        return fail("column " + name + " is wrong", describe(table, name));
+    }
+    return true;
+}
+
+static bool checkColumns()
+{
+    ColumnarTable table =
+        read(R"([{"a":1,"b":"x","c":true},{"b":"y","a":2.5},null,{"a":3,"d":[1, {"e":2}],"c":false}])");
+    if (table.rows != 4 || table.columns.size() != 4 || table.columns[3].name != "d")
+    {
+        return fail("wrong table shape", std::to_string(table.rows));
+    }
+    if (!expectColumn(table, "a", ColumnType::NUMBER, "1 2.5 null 3") ||
+        !expectColumn(table, "b", ColumnType::STRING, "[x] [y] null null") ||
+        !expectColumn(table, "c", ColumnType::BOOLEAN, "true null null false") ||
+        !expectColumn(table, "d", ColumnType::JSON, R"(null null null [[1,{"e":2}]])"))
+    {
+        return false;
+    }
+
+    // A second type turns the column into JSON text, including earlier rows
+    table = read(R"([{"a":1},{"a":"s"},{"a":true},{"a":null},{"a":0.1}])");
+    if (!expectColumn(table, "a", ColumnType::JSON, R"([1] ["s"] [true] null [0.1])"))
+    {
+        return false;
+    }
+
+    // Later duplicates win
+    table = read(R"([{"a":1,"a":2},{"a":null,"a":3}])");
+    if (!expectColumn(table, "a", ColumnType::NUMBER, "2 3"))
+    {
+        return false;
+    }
+
+    // Columns first seen late, and nulls across several validity words
+    std::string text = "[";
+    for (int i = 0; i < 200; i++)
+    {
+        text += i > 0 ? "," : "";
+        text += "{\"id\":" + std::to_string(i) + (i % 3 ? ",\"n\":null" : ",\"s\":\"v\"") + "}";
+    }
+    text += "]";
+    table = read(text);
+    double sum = 0;
+    for (double value : table.column("id")->numbers)
+    {
+        sum += value;
+    }
+    const Column *s = table.column("s");
+    const Column *n = table.column("n");
+    if (table.rows != 200 || sum != 19900 || !s->isNull(1) || s->isNull(129) || s->text(129) != "v" ||
+        n->type != ColumnType::NULL_VALUE || n->valid.size() != 4 || !n->isNull(199))
+    {
+        return fail("wide table is wrong", text);
+    }
+
+    if (read("[]").rows != 0 || read(" [ ] ").columns.size() != 0)
+    {
+        return fail("empty array not read", "[]");
+    }
+    return true;
+}
+
+static bool checkNumbers()
+{
+    ColumnarTable table = read(R"([{"x":5e-324},{"x":-0},{"x":1e-400}])");
+    const Column *x = table.column("x");
+    if (x->number(0) != 5e-324 || x->number(1) != 0 || !std::signbit(x->number(1)) || x->number(2) != 0)
+    {
+        return fail("numbers not read exactly", describe(table, "x"));
+    }
+    return true;
+}
+
+static bool checkRejected()
+{
+    const char *rejected[] = {
+        "{}", "[1]", R"([{"a":[1,]}])", R"([{"a":1},])", R"([{"a":1}] x)", R"([{"a":1e400}])", R"([{"a":}])", "[",
+    };
+    for (const char *text : rejected)
+    {
+        try
+        {
+            read(text);
+        }
+        catch (const ParseError &)
+        {
+            continue;
+        }
+        return fail("bad input accepted", text);
+    }
+    return true;
+}
+
+int main()
+{
+    if (!checkColumns() || !checkNumbers() || !checkRejected())
+    {
+        return 1;
+    }
+    std::cout << "ok\n";
+    return 0;
+}
@@ -0,0 +1,137 @@
+// hash_check - structural hashes, deepEquals, DedupTable and diffJson
+//
+// Compares documents that differ in member order, number sign and nesting,
+// shares the repeated subtrees of a document, and lists the changes between
+// two documents, including a diff of a very deeply nested pair.
+//
+// Exits with status 1 and prints what failed on the first failure.
+
+#include "structural_hash.hpp"
+#include <iostream>
+#include <string>
+
+static JsonPtr parse(const std::string &text, size_t maxDepth = Parser::DEFAULT_MAX_DEPTH,
+                     InternTable *keys = nullptr)
+{
+    Lexer lexer(text);
+    Parser parser(lexer, maxDepth);
+    parser.setInternTable(keys);
+    return parser.parse();
+}
+
+static bool fail(const std::string &what, const std::string &text)
+{
+    std::cout << "FAIL: " << what << "\n" << text << "\n";
+    return false;
+}
+
+static bool checkEquality()
+{
+    JsonPtr a = parse(R"({"a":1,"b":[1,2,{"c":"x"}],"d":-0})");
+    JsonPtr b = parse(R"({"b":[1,2,{"c":"x"}],"a":1,"d":0})");
+    JsonPtr c = parse(R"({"a":1,"b":[1,2,{"c":"y"}],"d":0})");
+
+    // Both kinds of hash from one cache, asked for in turn
+    HashCache cache;
+    for (int round = 0; round < 2; round++)
+    {
+        if (cache.hash(*a) == cache.hash(*b) || cache.hash(*a, true) != cache.hash(*b, true))
+        {
+            return fail("member order not handled by the hash", a->toString());
+        }
+    }
+    size_t hashed = cache.size();
+    cache.hash(*c);
+    cache.hash(*c, true);
+    if (cache.size() != hashed + 8)
+    {
+        return fail("cache does not hold one entry per node", c->toString());
+    }
+
+    if (deepEquals(*a, *b) || !deepEquals(*a, *b, true) || deepEquals(*a, *c, true, cache))
+    {
+        return fail("deepEquals gave the wrong answer", a->toString());
+    }
+    if (!deepEquals(*parse("[0]"), *parse("[-0]")) || deepEquals(*parse("[1]"), *parse("[true]")))
+    {
+        return fail("deepEquals mixed up scalars", "[0] [-0] [1] [true]");
+    }
+
+    // Keys interned in different tables are compared by text
+    InternTable first, second;
+    const std::string text = R"({"a long member name":{"k":1}})";
+    JsonPtr x = parse(text, Parser::DEFAULT_MAX_DEPTH, &first);
+    JsonPtr y = parse(text, Parser::DEFAULT_MAX_DEPTH, &second);
+    if (!deepEquals(*x, *y) || !deepEquals(*x, *parse(text)))
+    {
+        return fail("keys from different intern tables differ", text);
+    }
+    return true;
+}
+
+static bool checkDedup()
+{
+    JsonPtr doc = parse(R"([[1,2],[1,2],{"k":[1,2]},{"k":[1,2]},"s","s"])");
+    DedupTable table;
+    JsonPtr shared = table.intern(doc);
+    const auto &elements = static_cast<const JsonArray &>(*shared).elements;
+    const auto &inner = static_cast<const JsonObject &>(*elements[2]).properties;
+    if (elements[0] != elements[1] || elements[2] != elements[3] || elements[4] != elements[5] ||
+        inner[0].second != elements[0])
+    {
+        return fail("equal subtrees not shared", shared->toString());
+    }
+    if (table.size() != 6)
+    {
+        return fail("unexpected number of distinct subtrees", std::to_string(table.size()));
+    }
+
+    // A later document shares what the table already holds
+    JsonPtr later = table.intern(parse(R"({"x":[[1,2]]})"));
+    const auto &x = static_cast<const JsonObject &>(*later).properties[0].second;
+    if (static_cast<const JsonArray &>(*x).elements[0] != elements[0])
+    {
+        return fail("subtree from an earlier document not shared", later->toString());
+    }
+    if (shared->toString() != doc->toString())
+    {
+        return fail("interning changed the document", shared->toString());
+    }
+    return true;
+}
+
+static bool checkDiff()
+{
+    JsonPtr before = parse(R"({"a":1,"b":[1,2,{"c":"x"}],"d":-0,"a/b~":1})");
+    JsonPtr after = parse(R"({"e":true,"a/b~":2,"b":[1,2,{"c":"y"},3],"a":1})");
+    std::string got;
+    for (const JsonDifference &d : diffJson(before, after))
+    {
+        got += std::to_string(static_cast<int>(d.kind)) + " " + d.path + ";";
+    }
+    if (got != "2 /b/2/c;0 /b/3;1 /d;2 /a~1b~0;0 /e;")
+    {
+        return fail("wrong differences", got);
+    }
+
+    // Deep nesting is walked without recursion
+    std::string deep(100000, '[');
+    deep += std::string(100000, ']');
+    JsonPtr left = parse(deep, 200000);
+    JsonPtr right = parse(deep, 200000);
+    if (!deepEquals(*left, *right) || !diffJson(left, right).empty())
+    {
+        return fail("deep documents differ", "100000 nested arrays");
+    }
+    return true;
+}
+
+int main()
+{
+    if (!checkEquality() || !checkDedup() || !checkDiff())
+    {
+        return 1;
+    }
+    std::cout << "ok\n";
+    return 0;
+}
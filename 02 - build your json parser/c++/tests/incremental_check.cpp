@@ -0,0 +1,189 @@
+// incremental_check - randomized check of IncrementalDocument::edit
+//
+// Applies random edits to a small document and compares every result with a
+// fresh parse of the edited text: valid edits must give the same tree with
+// correct spans, invalid ones must be rejected and leave the text unchanged.
+// A few fixed edits that change a container's own brackets run first.
+//
+// Exits with status 1 and prints the offending text on the first failure.
+
+#include "incremental.hpp"
+#include "structural_scan.hpp"
+#include <algorithm>
+#include <iostream>
+#include <random>
+#include <string>
+
+static std::string freshParse(const std::string &text)
+{
+    Lexer lexer(text);
+    Parser parser(lexer);
+    return parser.parse()->toString();
+}
+
+// True if every container's span, and the start of every value, matches
+// the text of the value (scalars end where scanValue says)
+static bool spansMatch(const IncrementalDocument &doc, const JsonValue &value, size_t start)
+{
+    const std::string &text = doc.text();
+    size_t length;
+    if (value.type == JsonType::OBJECT || value.type == JsonType::ARRAY)
+    {
+        length = doc.spanLength(value);
+    }
+    else
+    {
+        length = scanValue(text.data(), text.size(), start) - start;
+    }
+    if (freshParse(text.substr(start, length)) != value.toString())
+    {
+        return false;
+    }
+    if (value.type == JsonType::OBJECT)
+    {
+        const auto &properties = static_cast<const JsonObject &>(value).properties;
+        for (size_t i = 0; i < properties.size(); i++)
+        {
+            if (!spansMatch(doc, *properties[i].second, start + doc.childOffset(value, i)))
+            {
+                return false;
+            }
+        }
+    }
+    else if (value.type == JsonType::ARRAY)
+    {
+        const auto &elements = static_cast<const JsonArray &>(value).elements;
+        for (size_t i = 0; i < elements.size(); i++)
+        {
+            if (!spansMatch(doc, *elements[i], start + doc.childOffset(value, i)))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+static bool fail(const std::string &what, const std::string &text)
+{
+    std::cout << "FAIL: " << what << "\n" << text << "\n";
+    return false;
+}
+
+// Applies one edit and checks the outcome against a full parse
+static bool checkEdit(IncrementalDocument &doc, size_t offset, size_t length, const std::string &replacement,
+                      bool &accepted)
+{
+    std::string before = doc.text();
+    std::string expected = before;
+    expected.replace(offset, length, replacement);
+
+    std::string want;
+    bool valid = true;
+    try
+    {
+        want = freshParse(expected);
+    }
+    catch (const ParseError &)
+    {
+        valid = false;
+    }
+
+    try
+    {
+        doc.edit(offset, length, replacement);
+    }
+    catch (const ParseError &)
+    {
+        accepted = false;
+        if (valid)
+        {
+            return fail("valid edit rejected", expected);
+        }
+        if (doc.text() != before)
+        {
+            return fail("rejected edit not reverted", doc.text());
+        }
+        return true;
+    }
+
+    accepted = true;
+    if (!valid)
+    {
+        return fail("invalid edit accepted", expected);
+    }
+    if (doc.root()->toString() != want)
+    {
+        return fail("tree differs from a full parse", doc.text());
+    }
+    if (!spansMatch(doc, *doc.root(), doc.rootOffset()))
+    {
+        return fail("spans do not match the text", doc.text());
+    }
+    return true;
+}
+
+int main()
+{
+    // Edits that only parse one or more levels above the innermost container
+    struct Case
+    {
+        const char *text;
+        size_t offset;
+        size_t length;
+        const char *replacement;
+    };
+    const Case cases[] = {
+        {"[[1,2]]", 3, 1, "],["},                     // split an array
+        {"[[1],[2]]", 3, 3, ","},                     // merge two arrays
+        {"{\"a\":[1,2],\"b\":3}", 7, 1, "],\"c\":["}, // split into two members
+        {"[[[1,2]]]", 4, 1, "]],[["},                 // split two levels up
+    };
+    for (const Case &c : cases)
+    {
+        IncrementalDocument doc(c.text);
+        bool accepted;
+        if (!checkEdit(doc, c.offset, c.length, c.replacement, accepted))
+        {
+            return 1;
+        }
+    }
+
+    const std::string start = " {\"a\": [1, 2, {\"b\": \"x\"}], \"c\": {\"d\": [true, null], \"e\": {}}, \"f\": [ ]} ";
+    const char *fragments[] = {"7", "\"s\"", ",", "]", "{\"k\":1}", "", " ", "[1,[2]]", ", 3", "\"q\":0,", "],[", "},{"};
+    const size_t fragmentCount = sizeof(fragments) / sizeof(fragments[0]);
+
+    IncrementalDocument doc(start);
+    std::mt19937 rng(7);
+    size_t accepted = 0;
+    size_t rejected = 0;
+    size_t partial = 0;
+    for (int i = 0; i < 20000; i++)
+    {
+        size_t offset = rng() % (doc.text().size() + 1);
+        size_t length = std::min<size_t>(rng() % 4, doc.text().size() - offset);
+        bool ok;
+        if (!checkEdit(doc, offset, length, fragments[rng() % fragmentCount], ok))
+        {
+            return 1;
+        }
+        if (!ok)
+        {
+            rejected++;
+            continue;
+        }
+        accepted++;
+        if (doc.lastReparsedBytes() < doc.text().size())
+        {
+            partial++;
+        }
+        if (doc.text().size() > 400)
+        {
+            doc.edit(0, doc.text().size(), start);
+        }
+    }
+
+    std::cout << "ok: " << accepted << " edits accepted (" << partial << " reparsed in part), " << rejected
+              << " rejected\n";
+    return 0;
+}
@@ -0,0 +1,138 @@
+// lazy_check - LazyDocument lookups, iteration and rejected input
+//
+// Navigates a document by key, index and JSON Pointer and compares what is
+// found with the expected values and with a full parse; then feeds documents
+// that must be rejected up front.
+//
+// Exits with status 1 and prints what failed on the first failure.
+
+#include "lazy_document.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+static bool fail(const std::string &what, const std::string &text)
+{
+    std::cout << "FAIL: " << what << "\n" << text << "\n";
+    return false;
+}
+
+// True if action throws a std::runtime_error (ParseError included)
+template <typename Action>
+static bool throws(Action action)
+{
+    try
+    {
+        action();
+    }
+    catch (const std::runtime_error &)
+    {
+        return true;
+    }
+    return false;
+}
+
+static std::string fullParse(const std::string &text)
+{
+    Lexer lexer(text);
+    Parser parser(lexer);
+    return parser.parse()->toString();
+}
+
+static bool checkLookups()
+{
+    const std::string text = R"( {"a/b": {"m~n": [1, {"x\"y": true}]}, "kA": 5, "s": "té\n",
+        "dup": 1, "list": [10, [20, 30], {"in": null}], "dup": 2, "empty": {}, "none": []} )";
+    LazyDocument doc(text);
+
+    if (!doc.at("/a~1b/m~0n/1/x\"y").asBool() || doc.at("/kA").raw() != "5" ||
+        doc.at("/s").asString() != "t\xc3\xa9\n" || doc.at("/dup").asNumber() != 2 ||
+        doc.root().get("list").get(1).get(size_t(1)).asNumber() != 30 ||
+        doc.at("/list/2/in").type() != JsonType::NULL_VALUE || doc.at("").type() != JsonType::OBJECT)
+    {
+        return fail("lookup found the wrong value", text);
+    }
+
+    const char *missing[] = {"/nope", "/list/3", "/list/01", "/list/-", "/list/x", "/kA/0", "/empty/a", "/none/0"};
+    for (const char *pointer : missing)
+    {
+        if (doc.at(pointer))
+        {
+            return fail("missing value found", pointer);
+        }
+    }
+
+    // Subtrees are parsed on request exactly as a full parse would
+    if (doc.at("/list").parse()->toString() != fullParse(doc.at("/list").raw()) ||
+        doc.root().parse()->toString() != fullParse(text))
+    {
+        return fail("parse() differs from a full parse", text);
+    }
+
+    // Scalar accessors refuse values of another type, and pointers must
+    // start with a slash
+    if (!throws([&] { doc.at("/list").asNumber(); }) || !throws([&] { doc.at("/kA").asString(); }) ||
+        !throws([&] { doc.at("a"); }))
+    {
+        return fail("bad access not rejected", text);
+    }
+    return true;
+}
+
+static bool checkIteration()
+{
+    LazyDocument doc(R"({"a": 1, "b": [true, "x", {}], "a": 3})");
+    std::string seen;
+    for (const LazyMember &member : doc.root())
+    {
+        seen += member.key + "=" + member.value.raw() + ";";
+    }
+    for (const LazyMember &member : doc.at("/b"))
+    {
+        seen += "[" + member.key + "]" + member.value.raw() + ";";
+    }
+    for (const LazyMember &member : doc.at("/b/2"))
+    {
+        seen += "never " + member.key;
+    }
+    if (seen != R"(a=1;b=[true, "x", {}];a=3;[]true;[]"x";[]{};)")
+    {
+        return fail("iteration saw the wrong children", seen);
+    }
+    return true;
+}
+
+static bool checkRejected()
+{
+    const char *rejected[] = {"[1,]", R"({"a":1} 2)", R"({"a":[1,{"b":1e400}]})", "", "[", R"({"a" 1})"};
+    for (const char *text : rejected)
+    {
+        if (!throws([&] { LazyDocument doc(text); }))
+        {
+            return fail("malformed document accepted", text);
+        }
+    }
+
+    // The nesting limit is checked up front; deep subtrees parse on request
+    std::string deep = std::string(50, '[') + std::string(50, ']');
+    if (!throws([&] { LazyDocument doc(deep, 10); }))
+    {
+        return fail("nesting limit ignored", deep);
+    }
+    LazyDocument doc(deep, 50);
+    if (doc.at("/0/0/0").parse()->toString() != fullParse(std::string(47, '[') + std::string(47, ']')))
+    {
+        return fail("nested subtree parsed wrongly", deep);
+    }
+    return true;
+}
+
+int main()
+{
+    if (!checkLookups() || !checkIteration() || !checkRejected())
+    {
+        return 1;
+    }
+    std::cout << "ok\n";
+    return 0;
+}
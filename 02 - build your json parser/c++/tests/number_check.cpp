@@ -0,0 +1,152 @@
+// number_check - numeric edge cases through every way of reading a document
+//
+// Each number is read with Parser::parse, Parser::validate and LazyDocument,
+// which must agree on whether it is accepted and, when it is, on its value:
+// tiny numbers round to the nearest double (a denormal or zero), only
+// numbers too large for a double are rejected, and -0 keeps its sign.
+//
+// Exits with status 1 and prints what failed on the first failure.
+
+#include "json_parser.hpp"
+#include "lazy_document.hpp"
+#include <cmath>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+static bool fail(const std::string &what, const std::string &text)
+{
+    std::cout << "FAIL: " << what << "\n" << text << "\n";
+    return false;
+}
+
+static bool sameBits(double a, double b)
+{
+    return std::memcmp(&a, &b, sizeof(a)) == 0;
+}
+
+// Reads text, a one-element array, every way there is; value is the element
+static bool readAll(const std::string &text, bool &accepted, double &value)
+{
+    bool parsed = true;
+    double parsedValue = 0;
+    try
+    {
+        Lexer lexer(text);
+        Parser parser(lexer);
+        JsonPtr root = parser.parse();
+        parsedValue = static_cast<const JsonNumber &>(*static_cast<const JsonArray &>(*root).elements[0]).value;
+    }
+    catch (const ParseError &)
+    {
+        parsed = false;
+    }
+
+    bool validated = true;
+    try
+    {
+        Lexer lexer(text);
+        Parser parser(lexer);
+        parser.validate();
+    }
+    catch (const ParseError &)
+    {
+        validated = false;
+    }
+
+    bool lazy = true;
+    double lazyValue = 0;
+    try
+    {
+        LazyDocument doc(text);
+        lazyValue = doc.at("/0").asNumber();
+    }
+    catch (const std::runtime_error &)
+    {
+        lazy = false;
+    }
+
+    if (parsed != validated || parsed != lazy)
+    {
+        return fail("parse, validate and lazy disagree", text);
+    }
+    if (parsed && !sameBits(parsedValue, lazyValue))
+    {
+        return fail("parse and lazy read different values", text);
+    }
+    accepted = parsed;
+    value = parsedValue;
+    return true;
+}
+
+int main()
+{
+    struct Case
+    {
+        const char *text;
+        double value; // as a C++ literal; ignored when rejected
+        bool accepted;
+    };
+    const Case cases[] = {
+        {"[5e-324]", 5e-324, true},
+        {"[-5e-324]", -5e-324, true},
+        {"[2.2250738585072014e-308]", 2.2250738585072014e-308, true},
+        {"[1e-400]", 0, true},
+        {"[-1e-400]", -0.0, true},
+        {"[-0]", -0.0, true},
+        {"[-0.0e5]", -0.0, true},
+        {"[0]", 0, true},
+        {"[1.7976931348623157e308]", 1.7976931348623157e308, true},
+        {"[0.1000000000000000055511151231257827]", 0.1, true},
+        {"[123456789012345678901234567890]", 123456789012345678901234567890.0, true},
+        {"[1e400]", 0, false},
+        {"[-1e400]", 0, false},
+        {"[1.8e308]", 0, false},
+        {"[01]", 0, false},
+        {"[1.]", 0, false},
+        {"[.5]", 0, false},
+        {"[-]", 0, false},
+        {"[1e]", 0, false},
+        {"[+1]", 0, false},
+    };
+    for (const Case &c : cases)
+    {
+        bool accepted;
+        double value;
+        if (!readAll(c.text, accepted, value))
+        {
+            return 1;
+        }
+        if (accepted != c.accepted)
+        {
+            fail(c.accepted ? "number rejected" : "number accepted", c.text);
+            return 1;
+        }
+        if (accepted && !sameBits(value, c.value))
+        {
+            fail("number read as the wrong double", c.text);
+            return 1;
+        }
+    }
+
+    // The range check also applies deep inside a document being validated
+    bool rejected = false;
+    try
+    {
+        Lexer lexer(R"({"a":[1,{"b":[2,1e999]}]})");
+        Parser parser(lexer);
+        parser.validate();
+    }
+    catch (const ParseError &)
+    {
+        rejected = true;
+    }
+    if (!rejected)
+    {
+        fail("nested out of range number accepted", "1e999");
+        return 1;
+    }
+
+    std::cout << "ok\n";
+    return 0;
+}
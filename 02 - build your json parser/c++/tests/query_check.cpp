@@ -0,0 +1,133 @@
+// query_check - Query paths over NDJSON records, in both output formats
+//
+// Runs a few paths over records with repeated keys, shared path prefixes,
+// missing values, blank lines and invalid records, and compares the output
+// and the reported lines with what is expected; then checks that malformed
+// paths are rejected.
+//
+// Exits with status 1 and prints what failed on the first failure.
+
+#include "json_parser.hpp"
+#include "query.hpp"
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static bool fail(const std::string &what, const std::string &text)
+{
+    std::cout << "FAIL: " << what << "\n" << text << "\n";
+    return false;
+}
+
+static const std::string RECORDS = R"({"user":{"id":7,"name":"a\tb"},"tags":["x",{"k":[1, 2]}],"user":{"id":8}})"
+                                   "\n\n"
+                                   R"({"tags":[], "user": null, "x": {"deep": [[[]]]}})"
+                                   "\n"
+                                   R"({"user":{"id":}})"
+                                   "\n"
+                                   "[1,2]\n"
+                                   R"({"user":{"id":"s"}, "tags":["t", 1e400]})";
+
+// Runs the query over RECORDS; got is the output followed by "line N" for
+// each reported record
+static std::string run(QueryFormat format)
+{
+    Query query(".user.id, .tags[0], .tags[1].k, .");
+    OutputBuffer out;
+    std::vector<Query::LineError> errors = query.writeLines(RECORDS.data(), RECORDS.size(), format, out);
+    std::string got = out.str();
+    for (const Query::LineError &error : errors)
+    {
+        got += "line " + std::to_string(error.line) + "\n";
+    }
+    return got;
+}
+
+static bool checkLines()
+{
+    const std::string tsv = "8\tx\t[1,2]\t"
+                            R"({"user":{"id":7,"name":"a\tb"},"tags":["x",{"k":[1,2]}],"user":{"id":8}})"
+                            "\n"
+                            "\t\t\t"
+                            R"({"tags":[],"user":null,"x":{"deep":[[[]]]}})"
+                            "\n"
+                            "\t\t\t\n"
+                            "\t\t\t[1,2]\n"
+                            "\t\t\t\n"
+                            "line 4\nline 6\n";
+    if (run(QueryFormat::TSV) != tsv)
+    {
+        return fail("wrong TSV output", run(QueryFormat::TSV));
+    }
+
+    const std::string none = R"({".user.id":null,".tags[0]":null,".tags[1].k":null,)";
+    const std::string json = R"({".user.id":8,".tags[0]":"x",".tags[1].k":[1,2],".":)"
+                             R"({"user":{"id":7,"name":"a\tb"},"tags":["x",{"k":[1,2]}],"user":{"id":8}}})"
+                             "\n" +
+                             none + R"(".":{"tags":[],"user":null,"x":{"deep":[[[]]]}}})" "\n" +
+                             none + R"(".":null})" "\n" +
+                             none + R"(".":[1,2]})" "\n" +
+                             none + R"(".":null})" "\n" +
+                             "line 4\nline 6\n";
+    if (run(QueryFormat::JSON) != json)
+    {
+        return fail("wrong JSON output", run(QueryFormat::JSON));
+    }
+    return true;
+}
+
+static bool checkSingleRecord()
+{
+    Query query(".a");
+    OutputBuffer out;
+    const std::string good = " {\"a\": \"v\"} ";
+    query.write(good.data(), good.size(), QueryFormat::TSV, out);
+    if (out.str() != "v\n")
+    {
+        return fail("single record not written", out.str());
+    }
+
+    const std::string bad = "{\"a\": 1} {";
+    try
+    {
+        query.write(bad.data(), bad.size(), QueryFormat::TSV, out);
+    }
+    catch (const ParseError &)
+    {
+        if (out.str() != "v\n")
+        {
+            return fail("failed record wrote output", out.str());
+        }
+        return true;
+    }
+    return fail("invalid record accepted", bad);
+}
+
+static bool checkPaths()
+{
+    const char *malformed[] = {"", " , ", "a", ".a.", ".a[", ".a[x]", ".a[]", ".a[-1]", ".a,,.b"};
+    for (const char *paths : malformed)
+    {
+        try
+        {
+            Query query(paths);
+        }
+        catch (const std::runtime_error &)
+        {
+            continue;
+        }
+        return fail("malformed path accepted", paths);
+    }
+    return true;
+}
+
+int main()
+{
+    if (!checkLines() || !checkSingleRecord() || !checkPaths())
+    {
+        return 1;
+    }
+    std::cout << "ok\n";
+    return 0;
+}
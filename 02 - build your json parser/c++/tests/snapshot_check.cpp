@@ -0,0 +1,163 @@
+// snapshot_check - snapshot round trips and corrupt snapshots
+//
+// Writes documents as snapshots, reads them back in place and compares them
+// with the parsed tree, then damages the header, the child slots and random
+// bytes of a snapshot, which must be rejected with an exception rather than
+// read out of bounds.
+//
+// Exits with status 1 and prints what failed on the first failure.
+
+#include "snapshot.hpp"
+#include <cstring>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static JsonPtr parse(const std::string &text)
+{
+    Lexer lexer(text);
+    Parser parser(lexer);
+    return parser.parse();
+}
+
+// Snapshot bytes in 8-byte aligned storage, as Snapshot::attach requires
+static std::vector<uint64_t> snapshotOf(const std::string &text, size_t &size)
+{
+    std::ostringstream out;
+    writeSnapshot(*parse(text), out);
+    std::string bytes = out.str();
+    size = bytes.size();
+    std::vector<uint64_t> storage((size + 7) / 8);
+    std::memcpy(storage.data(), bytes.data(), size);
+    return storage;
+}
+
+static bool fail(const std::string &what, const std::string &text)
+{
+    std::cout << "FAIL: " << what << "\n" << text << "\n";
+    return false;
+}
+
+// Reads everything in the snapshot; false if an exception was thrown
+static bool readsCleanly(const std::vector<uint64_t> &storage, size_t size)
+{
+    try
+    {
+        Snapshot snapshot;
+        snapshot.attach(reinterpret_cast<const char *>(storage.data()), size);
+        snapshot.root().toJson()->toString();
+    }
+    catch (const std::runtime_error &)
+    {
+        return false;
+    }
+    return true;
+}
+
+static bool checkRoundTrip()
+{
+    const char *documents[] = {
+        R"({"a":1,"b":[true,false,null,"x"],"c":{"d":{},"e":[]},"a":3})",
+        R"([-0,5e-324,1.7976931348623157e308,0.1,-12,"é\n\"",""])",
+        R"("just a string")",
+        R"(42)",
+        R"([{"k":"same"},{"k":"same"},{"same":"k"}])",
+    };
+    for (const char *text : documents)
+    {
+        size_t size;
+        std::vector<uint64_t> storage = snapshotOf(text, size);
+        Snapshot snapshot;
+        snapshot.attach(reinterpret_cast<const char *>(storage.data()), size);
+        if (snapshot.root().toJson()->toString() != parse(text)->toString())
+        {
+            return fail("snapshot reads back differently", text);
+        }
+    }
+
+    // Accessors read straight from the bytes; repeated keys give the last
+    size_t size;
+    std::vector<uint64_t> storage = snapshotOf(documents[0], size);
+    Snapshot snapshot;
+    snapshot.attach(reinterpret_cast<const char *>(storage.data()), size);
+    SnapshotValue root = snapshot.root();
+    if (root.size() != 4 || root.keyAt(1) != "b" || root.find("a").asNumber() != 3 ||
+        root.find("b").at(3).asString() != "x" || !root.find("b").at(0).asBool() ||
+        root.find("c").find("e").type() != JsonType::ARRAY || root.find("missing") || root.find("b").at(4))
+    {
+        return fail("accessors gave the wrong values", documents[0]);
+    }
+    return true;
+}
+
+static bool checkCorrupt()
+{
+    const std::string text = R"({"a":[1,2,{"b":"c"}],"d":"e","f":[[],{}]})";
+    size_t size;
+    const std::vector<uint64_t> original = snapshotOf(text, size);
+    const SnapshotHeader header = *reinterpret_cast<const SnapshotHeader *>(original.data());
+    const size_t childStart = sizeof(SnapshotHeader) + header.nodeCount * sizeof(SnapshotNode);
+
+    std::vector<uint64_t> damaged = original;
+    char *bytes = reinterpret_cast<char *>(damaged.data());
+    bytes[0] = 'X';
+    if (readsCleanly(damaged, size))
+    {
+        return fail("bad magic accepted", text);
+    }
+    if (readsCleanly(original, size - 8) || readsCleanly(original, sizeof(SnapshotHeader) - 1))
+    {
+        return fail("truncated snapshot accepted", text);
+    }
+
+    // A child slot that points back at the root would make it contain itself
+    damaged = original;
+    bytes = reinterpret_cast<char *>(damaged.data());
+    for (size_t i = 0; i < header.childCount; i++)
+    {
+        uint64_t root = 0;
+        std::memcpy(bytes + childStart + i * sizeof(uint64_t), &root, sizeof(root));
+    }
+    if (readsCleanly(damaged, size))
+    {
+        return fail("child pointing at its container accepted", text);
+    }
+
+    damaged = original;
+    bytes = reinterpret_cast<char *>(damaged.data());
+    uint64_t past = header.nodeCount;
+    std::memcpy(bytes + childStart, &past, sizeof(past));
+    if (readsCleanly(damaged, size))
+    {
+        return fail("child past the last node accepted", text);
+    }
+
+    // Random damage to nodes and child slots may be accepted or rejected,
+    // but must never read outside the snapshot
+    std::mt19937 rng(11);
+    for (int i = 0; i < 5000; i++)
+    {
+        damaged = original;
+        bytes = reinterpret_cast<char *>(damaged.data());
+        for (int j = 0; j < 3; j++)
+        {
+            size_t at = sizeof(SnapshotHeader) + rng() % (size - sizeof(SnapshotHeader));
+            bytes[at] = static_cast<char>(rng());
+        }
+        readsCleanly(damaged, size);
+    }
+    return true;
+}
+
+int main()
+{
+    if (!checkRoundTrip() || !checkCorrupt())
+    {
+        return 1;
+    }
+    std::cout << "ok\n";
+    return 0;
+}